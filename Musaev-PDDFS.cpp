@@ -1,15 +1,30 @@
 /**
  * Implementation of Musaev's Parallel Distributed Depth First Search algorithm
+ * This program is the command line driver of the protocol in pddfs.cpp, applications can link the library instead (pddfs.h)
  * The program takes all the edges of the graph as input on STDIN
  * An edge is defined by the two nodes it connects, and the two nodes are separated by a space
+ * An optional third number is the ordering key of the edge: the DFS explores lower keys first (ties by ID), e.g. weights or ranks
  * Directed graphs are supported as input, but they are not supported by the algorithm.
  * For undirected graphs edges need to be specified in both directions.
- * Edges are expected in sorted order, sorted by the first (source) node
+ * Edges may come in any order, input sorted by the first (source) node is loaded without sorting
+ * Alternatively, with --csr <file>, the graph is memory-mapped from a file written by csr_convert
+ * With --order bfs|rcm vertices are hosted by ranks in a locality-improving order, the result and output still use the input IDs
+ * With --autotune [policy|cut] the order is chosen from the loaded graph and the huge pages from the kernel instead (TUNE line), see autotune.h
  * For a complete graph with two nodes {0,1} (and one edge), input will look as follows:
  * 0 1
  * 1 0
  * When the program is done, each node knows its parent and children in the DFS tree (if successful)
  * Each node prints its children list on termination such that proper execution can be verified
+ * After all nodes are done, a breakdown of the time spent per phase (PHASES line) is printed
+ * With --profile-handlers the metrics report also breaks the protocol phase down per handler, see handler_profile.h
+ * With --progress <seconds> the root prints the mounted and terminated vertices and message rates while running (PROGRESS lines)
+ * With --imbalance [top] the busy and idle time per process is summarised and the busiest processes are listed, see imbalance.h
+ * With --comm-matrix <file> the messages and bytes sent between every pair of processes are written to a file, see comm_matrix.h
+ * With --record <prefix> the order of handled messages is logged, --replay <prefix> reproduces that run exactly, see message_log.h
+ * SIGUSR1 makes every process append its state to a dump file (pddfs-dump.<rank>, see --dump-prefix) without stopping the run,
+ * processes whose vertex has already terminated dump its final state
+ * With --tree-stream <file> every vertex appends its final parent and children to a file as soon as its subtree is done, see tree_stream.h
+ * With --latency the send-to-handle latency of every message type is printed (LATENCY lines), see latency.h
  * 
  * @author Gert Hartzema <g.hartzema@student.vu.nl>
  * Date: August 26, 2020
@@ -20,39 +35,28 @@
 #include <mpi.h>
 #include <string>
 #include <signal.h>
-#include <set>
-#include <thread>
 #include <chrono>
+#include <climits>
 #include <iostream>
-
-#define DEBUG_PRINT false // toggle debug printing
-#define DISCOVER_TYPE 1
-#define REJECT_TYPE 2
-#define TERMINATE_TYPE 3
-
-/**
- * Array to string for debug printing
- */
-std::string to_str(int n, int arr[])
-{
-    std::string out = "[";
-    for (int i = 0; i < n; i++)
-        out += std::to_string(arr[i]) + ", ";
-    out += "]";
-    return out;
-}
-
-/**
- * Set to string for debug printing
- */
-std::string to_arr(std::set<int> elems)
+#include <vector>
+#include "autotune.h"
+#include "comm_matrix.h"
+#include "compressed_adjacency.h"
+#include "handler_profile.h"
+#include "imbalance.h"
+#include "large_pages.h"
+#include "latency.h"
+#include "mapped_csr.h"
+#include "metrics.h"
+#include "pddfs_driver.h"
+#include "placement.h"
+#include "reorder.h"
+#include "tree_stream.h"
+#include "vertex_state.h"
+
+void handle_sigusr1(int)
 {
-    std::string out;
-    out.push_back('[');
-    for (auto elem : elems)
-        out.append(std::to_string(elem) + ", ");
-    out.push_back(']');
-    return out;
+    pddfs_request_dump();
 }
 
 void handle_sigint(int n)
@@ -63,130 +67,261 @@ void handle_sigint(int n)
 }
 
 /**
- * Takes edges sorted by source on stdin, returns graph communicator
+ * Decide which rank hosts which vertex, collective
+ * Rank 0 computes the ordering and broadcasts the rank-to-vertex table, vertices missing from the graph keep their own rank.
+ * When tuning is requested, rank 0 first chooses the ordering from the graph and the machines of the ranks.
  * 
  * @param rank The MPI process ID of the current process
  * @param size The amount of processes in the graph
- * @param comm The graph communicator that is written to
- * @return The passed graph communicator is loaded with topology data, each process becomes aware of its neighbours
+ * @param graph The adjacency, only read on rank 0
+ * @param kind The ordering to use, replaced by the tuned one
+ * @param tune The requested tuning
+ * @param ids The translation tables that are written to, left empty for ORDER_NONE
  */
-void load_graph(int rank, int size, MPI_Comm *comm)
+void distribute_order(int rank, int size, const AdjacencyView &graph, VertexOrder kind, const TuneSettings &tune, VertexIds *ids)
 {
-    if (rank == 0)
+    if (tune.mode != TUNE_OFF)
     {
-        int n = 0;
-        int edges = 0;
-        int sources[size];
-        int degrees[size] = {0};
-        int destinations[size * (size - 1)];
-        MPI_Info info;
-        MPI_Info_create(&info);
-        std::string line;
-        int source, dest;
-
-        while (getline(std::cin, line))
-        {
-            sscanf(line.c_str(), "%i %i", &source, &dest);
-            if (n == 0 || sources[n - 1] != source)
-            {
-                sources[n] = source;
-                n++;
-            }
-            degrees[n - 1]++;
-            destinations[edges] = dest;
-            edges++;
-        }
-        MPI_Dist_graph_create(MPI_COMM_WORLD, n, sources, degrees, destinations, MPI_UNWEIGHTED, info, false, comm);
+        std::vector<int> machine = machine_of_ranks(MPI_COMM_WORLD, 0, tune.numa);
+        if (rank == 0)
+            tune_order(graph, machine, tune.mode, tune.policy, &kind, stdout);
+        int chosen = kind;
+        MPI_Bcast(&chosen, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        kind = (VertexOrder)chosen;
     }
-    else
+    if (kind == ORDER_NONE)
+        return;
+    std::vector<int> order(size);
+    if (rank == 0)
     {
-        MPI_Info info;
-        MPI_Info_create(&info);
-        MPI_Dist_graph_create(MPI_COMM_WORLD, 0, NULL, NULL, NULL, MPI_UNWEIGHTED, info, false, comm);
+        order = vertex_order(graph, kind);
+        for (int v = graph.n; v < size; v++)
+            order.push_back(v);
     }
+    MPI_Bcast(order.data(), size, MPI_INT, 0, MPI_COMM_WORLD);
+    ids->assign(order);
 }
 
 /**
- * Send DISCOVER message to set of children
+ * Takes the edges on stdin, returns graph communicator
+ * Rank 0 gap-codes the adjacency (see compressed_adjacency.h) while reading, then scatters every row to the process that hosts it.
+ * Each process only ever decodes its own neighbour list.
  * 
- * @param dests The destinations to send DISCOVER to
- * @param path The path vector at the current node
- * @param path_length The size of the path vector
- * @param comm The communicator to write on
- * @return DISCOVER messages with the path vector (with destination ID appended) written to each destination channel
+ * @param rank The MPI process ID of the current process
+ * @param size The amount of processes in the graph
+ * @param kind The vertex ordering that decides which rank hosts which vertex
+ * @param tune The requested tuning of the ordering
+ * @param ids The rank/vertex translation tables that are written to
+ * @param comm The graph communicator that is written to
+ * @param phases Marks the "load" (reading and distributing) and "graph_create" phases
+ * @return The compressed neighbour row of the vertex on the current process, the passed graph communicator is loaded with topology data
  */
-void send_discover(std::set<int> dests, int path[], int path_length, MPI_Comm comm)
+std::vector<uint8_t> load_graph(int rank, int size, VertexOrder kind, const TuneSettings &tune, VertexIds *ids, MPI_Comm *comm, PhaseTimer &phases)
 {
-    MPI_Request request[dests.size()];
+    CompressedAdjacency adjacency;
+    int counts[size], displs[size];
 
-    path_length++;
-    int i = 0;
-    for (auto dest : dests)
+    if (rank == 0)
     {
-        path[path_length - 1] = dest;
-        MPI_Issend(path, path_length, MPI_INT, dest, DISCOVER_TYPE, comm, &request[i]);
-        i++;
+        read_edge_list(std::cin, adjacency, size);
+        int largest = adjacency.view().max_vertex();
+        if (largest >= size) // every vertex needs a rank, the translation tables only cover the ranks
+        {
+            std::cout << "the graph has vertex " << largest << ", one process per vertex is needed" << std::endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    distribute_order(rank, size, adjacency.view(), kind, tune, ids);
+    if (rank == 0)
+    {
+        for (int r = 0; r < size; r++)
+        {
+            int v = ids->original_id(r);
+            counts[r] = (int)adjacency.view().row_size(v);
+            displs[r] = (int)adjacency.offsets[v];
+        }
     }
-}
 
-/**
- * send_discover() overload for ease of use with a single destination
- */
-void send_discover(int dest, int path[], int path_length, MPI_Comm comm)
-{
-    std::set<int> dest_wrapper;
-    dest_wrapper.insert(dest);
-    send_discover(dest_wrapper, path, path_length, comm);
+    int row_size;
+    MPI_Scatter(counts, 1, MPI_INT, &row_size, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<uint8_t> row(row_size);
+    MPI_Scatterv(adjacency.bytes.data(), counts, displs, MPI_BYTE, row.data(), row_size, MPI_BYTE, 0, MPI_COMM_WORLD);
+    phases.mark("load");
+
+    std::vector<int> neighbour_ranks;
+    for (int v : NeighbourRange(row.data()))
+        neighbour_ranks.push_back(ids->rank_of(v));
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD, neighbour_ranks.size(), neighbour_ranks.data(), MPI_UNWEIGHTED,
+                                   neighbour_ranks.size(), neighbour_ranks.data(), MPI_UNWEIGHTED, info, false, comm);
+    MPI_Info_free(&info);
+    phases.mark("graph_create");
+    return row;
 }
 
 /**
- * Send REJECT message to destination
- * 
- * @param dest The destination to send REJECT to
- * @param comm The communicator to write on
- * @return REJECT message written to the destination channel
+ * Maps a graph stored as mapped CSR file (see mapped_csr.h) instead of reading stdin
+ * Every process maps the file itself and only checks its own row here (see valid_row()), the row is decoded when it is mounted.
+ * A vertex ordering other than ORDER_NONE makes rank 0 check and scan the whole file once to compute it.
+ * The graph communicator is a duplicate of MPI_COMM_WORLD, the algorithm only uses point-to-point messages on it.
+ *
+ * @param rank The MPI process ID of the current process
+ * @param size The amount of processes in the graph
+ * @param path The mapped CSR file
+ * @param csr The mapping that is opened, must outlive the returned row
+ * @param kind The vertex ordering that decides which rank hosts which vertex
+ * @param tune The requested tuning of the ordering
+ * @param ids The rank/vertex translation tables that are written to
+ * @param comm The communicator that is written to
+ * @param phases Marks the "load" (mapping and ordering) and "graph_create" phases
+ * @return Pointer to the compressed neighbour row of the vertex on the current process
  */
-void send_reject(int dest, MPI_Comm comm)
+const uint8_t *load_mapped_graph(int rank, int size, const char *path, MappedCsr &csr, VertexOrder kind, const TuneSettings &tune,
+                                 VertexIds *ids, MPI_Comm *comm, PhaseTimer &phases)
 {
-    MPI_Request request;
-    MPI_Issend(NULL, 0, MPI_INT, dest, REJECT_TYPE, comm, &request);
+    static const uint8_t empty_row[1] = {0};
+
+    if (!csr.open(path) || csr.view().n > size)
+    {
+        if (rank == 0)
+            std::cout << "cannot map " << path << " as a graph of at most " << size << " vertices" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (rank == 0 && (kind != ORDER_NONE || tune.mode != TUNE_OFF) && !csr.valid_rows()) // the ordering decodes every row
+    {
+        std::cout << "corrupt rows in " << path << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    distribute_order(rank, size, csr.view(), kind, tune, ids);
+    int v = ids->original_id(rank);
+    int corrupt = v >= csr.view().n || csr.valid_row(v) ? INT_MAX : v, first_corrupt;
+    MPI_Allreduce(&corrupt, &first_corrupt, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD); // no process may start on a graph with a corrupt row
+    if (first_corrupt != INT_MAX)
+    {
+        if (rank == 0)
+            std::cout << "corrupt row of vertex " << first_corrupt << " in " << path << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    phases.mark("load");
+    MPI_Comm_dup(MPI_COMM_WORLD, comm);
+    phases.mark("graph_create");
+    if (v >= csr.view().n)
+        return empty_row;
+    return csr.view().bytes + csr.view().offsets[v];
 }
 
-/**
- * Send TERMINATE message to destination
- * 
- * @param parent The destination to send TERMINATE to
- * @param comm The communicator to write on
- * @return TERMINATE message written to the destination channel
- */
-void send_terminate(int parent, MPI_Comm comm, int rank = -1)
+struct Options
 {
-    MPI_Request request;
-    MPI_Issend(NULL, 0, MPI_INT, parent, TERMINATE_TYPE, comm, &request);
-}
+    const char *csr_path = NULL; // map the graph from this file instead of reading stdin
+    bool pin = false;            // bind every process to a core before its memory is allocated
+    LargePageMode pages = PAGES_DEFAULT;
+    VertexOrder order = ORDER_NONE; // which rank hosts which vertex
+    TuneSettings tune;              // choose the order from the loaded graph and the huge pages from the kernel
+    bool report = false;        // print the metrics report after the run
+    bool profile = false;       // account the cost of every handler, implies report
+    bool perf_counters = false; // also read hardware counters around every handler, implies profile
+    bool latency = false;       // stamp every message and print send-to-handle latency percentiles
+    double progress = 0;        // seconds between progress lines, 0 for none
+    int imbalance = 0;          // amount of busiest processes listed in the imbalance report, 0 for no report
+    const char *comm_matrix_path = NULL; // write the communication matrix to this file
+    bool comm_nodes = false;             // also write the matrix coarsened to machines
+    const char *record_prefix = NULL;    // log the handled message order to <prefix>.<rank>
+    const char *replay_prefix = NULL;    // handle messages in the order logged in <prefix>.<rank>
+    const char *dump_prefix = "pddfs-dump"; // SIGUSR1 appends the state of every process to <prefix>.<rank>
+    const char *tree_stream = NULL;         // append the record of every vertex to this file when its subtree is done
+};
 
 /**
- * Calculate path order, which path is 'more depth-first'
+ * Parse command line options
  * 
- * @param path_length_1 The length of the first path
- * @param path1 The first path vector
- * @param path_length2 The length of the second path
- * @param path2 The second path vector
- * @return -1 for path1 >_{df} path2, 1 for path1 <_{df} path2, 0 for path1 \subset_{df} path2 
+ * @param argc The argument count passed to main
+ * @param argv The arguments passed to main
+ * @param options The options that are written to
+ * @return false if an argument is not recognised
  */
-int path_order(int path_length_1, int path1[], int path_length_2, int path2[])
+bool parse_options(int argc, char *argv[], Options *options)
 {
-    for (int i = 0; i < std::min(path_length_1, path_length_2); i++)
+    for (int i = 1; i < argc; i++)
     {
-        if (path1[i] < path2[i])
-            return -1;
-        else if (path1[i] > path2[i])
-            return 1;
+        std::string arg = argv[i];
+        if (arg == "--csr" && i + 1 < argc)
+            options->csr_path = argv[++i];
+        else if (arg == "--pin")
+            options->pin = options->tune.numa = true;
+        else if (arg == "--hugepages" && i + 1 < argc)
+        {
+            std::string mode = argv[++i];
+            if (mode == "transparent")
+                options->pages = PAGES_TRANSPARENT;
+            else if (mode == "explicit")
+                options->pages = PAGES_EXPLICIT;
+            else
+                return false;
+        }
+        else if (arg == "--autotune")
+        {
+            options->tune.mode = TUNE_POLICY;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                std::string mode = argv[++i];
+                if (mode == "cut")
+                    options->tune.mode = TUNE_CUT;
+                else if (mode != "policy")
+                    return false;
+            }
+        }
+        else if (arg == "--autotune-policy" && i + 1 < argc)
+        {
+            if (!read_tune_policy(argv[++i], &options->tune.policy))
+                return false;
+        }
+        else if (arg == "--order" && i + 1 < argc)
+        {
+            if (!parse_vertex_order(argv[++i], &options->order))
+                return false;
+        }
+        else if (arg == "--report")
+            options->report = true;
+        else if (arg == "--profile-handlers")
+            options->profile = options->report = true;
+        else if (arg == "--progress" && i + 1 < argc)
+        {
+            options->progress = atof(argv[++i]);
+            if (options->progress <= 0)
+                return false;
+        }
+        else if (arg == "--imbalance")
+        {
+            options->imbalance = 5;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                options->imbalance = atoi(argv[++i]);
+            if (options->imbalance <= 0)
+                return false;
+        }
+        else if (arg == "--comm-matrix" && i + 1 < argc)
+            options->comm_matrix_path = argv[++i];
+        else if (arg == "--comm-nodes")
+            options->comm_nodes = true;
+        else if (arg == "--record" && i + 1 < argc)
+            options->record_prefix = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            options->replay_prefix = argv[++i];
+        else if (arg == "--dump-prefix" && i + 1 < argc)
+            options->dump_prefix = argv[++i];
+        else if (arg == "--tree-stream" && i + 1 < argc)
+            options->tree_stream = argv[++i];
+        else if (arg == "--latency")
+            options->latency = true;
+        else if (arg == "--perf-counters")
+            options->perf_counters = options->profile = options->report = true;
+        else
+            return false;
     }
-    return 0;
+    return options->record_prefix == NULL || options->replay_prefix == NULL; // a replayed run is not recorded again
 }
 
-int main()
+int main(int argc, char *argv[])
 {
 
     if (!DEBUG_PRINT)
@@ -198,168 +333,116 @@ int main()
     sigIntHandler.sa_flags = 0;
 
     sigaction(SIGINT, &sigIntHandler, NULL); // handle SIGINT
+    struct sigaction sigUsr1Handler;
+    sigUsr1Handler.sa_handler = handle_sigusr1;
+    sigemptyset(&sigUsr1Handler.sa_mask);
+    sigUsr1Handler.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sigUsr1Handler, NULL); // dump the state on SIGUSR1
+
+    Options options;
+    bool options_valid = parse_options(argc, argv, &options);
+    large_pages().mode = options.pages;
+    if (options.tune.mode != TUNE_OFF && options.pages == PAGES_DEFAULT)
+        large_pages().mode = tune_pages(); // before the graph is loaded, the mode never changes once memory is allocated
+    int core = -1;
+    if (options.pin)
+        core = pin_to_core(environment_local_rank()); // before MPI_Init, so MPI buffers are first touched on the right node
 
     int world_size, world_rank;
+    PhaseTimer phases;
+    auto init_start = std::chrono::steady_clock::now();
     MPI_Init(NULL, NULL);
+    phases.add("init", std::chrono::duration<double>(std::chrono::steady_clock::now() - init_start).count());
+    phases.start();
     MPI_Comm_size(MPI_COMM_WORLD, &world_size);
     MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
 
-    // containers for graph communicator topology info
-    int sources[world_size], dests[world_size], sweights[world_size],
-        dweights[world_size], outdegree, indegree, weighted;
-    MPI_Comm local;
-
-    load_graph(world_rank, world_size, &local);
+    if (!options_valid)
+    {
+        if (world_rank == 0)
+            std::cout << "usage: " << argv[0] << " [--csr <mapped csr file>] [--pin] [--hugepages transparent|explicit] [--order none|bfs|rcm] [--autotune [policy|cut]] [--autotune-policy <file>] [--report] [--profile-handlers] [--perf-counters] [--latency] [--progress <seconds>] [--imbalance [top]] [--comm-matrix <file> [--comm-nodes]] [--record <prefix> | --replay <prefix>] [--dump-prefix <prefix>] [--tree-stream <file>] [< edges]" << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (options.pin && core == -1)
+        core = pin_to_core(node_local_rank(MPI_COMM_WORLD));
 
-    MPI_Dist_graph_neighbors(local, world_size, sources, sweights, world_size, dests, dweights);
-    MPI_Dist_graph_neighbors_count(local, &indegree, &outdegree, &weighted);
+    MPI_Comm local;
+    VertexIds ids;
+    std::vector<uint8_t> loaded_row;
+    MappedCsr mapped;
+    const uint8_t *neighbour_row;
+    if (options.csr_path != NULL)
+        neighbour_row = load_mapped_graph(world_rank, world_size, options.csr_path, mapped, options.order, options.tune, &ids, &local, phases);
+    else
+    {
+        loaded_row = load_graph(world_rank, world_size, options.order, options.tune, &ids, &local, phases);
+        neighbour_row = loaded_row.data();
+    }
 
     // containers for algorithm functionality
-    std::set<int> children;
-    for (int i = 0; i < outdegree; i++)
-        children.insert(dests[i]); // all neighbours are added to children list, parent is removed upon first discovery
-
-    std::set<int> terminated_children;
-    int graph_path[world_size];
-    int path_length = 0;
-    int parent = -1;
-    int recv_path_length;
-    int recv_graph_path[world_size];
-    bool mounted = false;
-    bool is_parent_rejected = false;
-    int msgct = 0;
+    message_latency().enabled = options.latency;
+    comm_matrix().enabled = options.comm_matrix_path != NULL;
+    // paths have room for every vertex and the latency stamp, a keyed row means (key, vertex) entries
+    int max_path = path_entry_ints(NeighbourRange(neighbour_row).keyed()) * world_size + MESSAGE_STAMP_INTS;
+    VertexState state(ids.original_id(world_rank), max_path, ids); // children are filled when mounted: all neighbours are added to children list, parent is removed upon first discovery
 
     if (DEBUG_PRINT)
         freopen(("./debug_log/" + std::to_string(world_rank)).c_str(), "w+", stderr); // send debugprints to files, debug info from different processes is separated
-
-    if (world_rank == 0) // If current process is root, start the algorithm
+    if (options.pin)
+        std::cerr << "[" << world_rank << "]: pinned to core " << core << " on NUMA node " << current_numa_node() << std::endl;
+
+    if (options.profile)
+        handler_profile().enable(options.perf_counters);
+    PddfsConfig config;
+    config.progress = options.progress;
+    config.record_prefix = options.record_prefix;
+    config.replay_prefix = options.replay_prefix;
+    config.dump_prefix = options.dump_prefix;
+    if (options.tree_stream != NULL)
     {
-        mounted = true;
-        graph_path[0] = 0;
-        path_length = 1;
-        send_discover(children, graph_path, path_length, local);
+        if (world_rank == 0)
+            config.tree_stream = open_tree_stream(options.tree_stream, true);
+        MPI_Barrier(MPI_COMM_WORLD); // the file is emptied before any process appends to it
+        if (world_rank != 0)
+            config.tree_stream = open_tree_stream(options.tree_stream, false);
+        if (config.tree_stream < 0)
+            std::cout << "[" << state.id << "]: cannot open tree stream " << options.tree_stream << std::endl;
     }
-
-    while (1)
+    PddfsStats stats;
+    pddfs_protocol(state, neighbour_row, local, config, &stats);
+    if (config.tree_stream >= 0)
+        close(config.tree_stream);
+    phases.mark("protocol");
+
+    std::string out = "[" + std::to_string(state.id) + "]:\t DONE - Children: " + to_arr(state.neighbours.collect(NEIGHBOUR_CHILD)) + "\t\t" + std::to_string(stats.messages) + "\n";
+    std::cout << out;
+    phases.mark("output");
+
+    phases.print(MPI_COMM_WORLD, 0, stdout);
+    if (options.latency)
+        print_latency(MPI_COMM_WORLD, 0, stdout);
+    if (options.comm_matrix_path != NULL &&
+        !write_comm_matrix(MPI_COMM_WORLD, 0, options.comm_matrix_path, ids, options.comm_nodes, options.tune.numa))
+        std::cout << "cannot write communication matrix " << options.comm_matrix_path << std::endl;
+    if (options.imbalance > 0)
     {
-        MPI_Status status;
-        MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, local, &status);
-
-        msgct++;
-
-        switch (status.MPI_TAG)
-        {
-        case DISCOVER_TYPE:
-            std::cerr << "[" << world_rank << "]:"
-                      << "Got DISCOVER msg FROM: " << status.MPI_SOURCE << "\t\t";
-            {
-                if (!mounted) // Node is not yet attached to DFS tree
-                {
-                    std::cerr << "For the first time " << std::endl;
-
-                    mounted = true;
-                    parent = status.MPI_SOURCE;
-                    children.erase(parent);
-                    MPI_Get_count(&status, MPI_INT, &path_length);
-
-                    MPI_Recv(&graph_path, path_length, MPI_INT, parent, DISCOVER_TYPE, local, MPI_STATUS_IGNORE);
-
-                    send_discover(children, graph_path, path_length, local);
-                }
-                else if (status.MPI_SOURCE == parent)
-                { // sometimes you may get the same path you already have, ignore this.
-                    MPI_Get_count(&status, MPI_INT, &recv_path_length);
-                    MPI_Recv(recv_graph_path, recv_path_length, MPI_INT, status.MPI_SOURCE, DISCOVER_TYPE, local, MPI_STATUS_IGNORE); // take message off the queue
-                    std::cerr << "From parent with path: " << to_str(recv_path_length, recv_graph_path) << std::endl;
-                    if (path_order(path_length, graph_path, recv_path_length, recv_graph_path) == 1)
-                    {
-                        std::copy(recv_graph_path, recv_graph_path + recv_path_length, graph_path); // sometimes the path from parent is better, update own path to save some work
-                        path_length = recv_path_length;
-                    }
-                }
-                else // Node is already part of DFS tree
-                {
-                    MPI_Get_count(&status, MPI_INT, &recv_path_length);
-                    MPI_Recv(&recv_graph_path, recv_path_length, MPI_INT, status.MPI_SOURCE, DISCOVER_TYPE, local, &status);
-                    std::cerr << "WITH PATH: " << to_str(recv_path_length, recv_graph_path) << std::endl;
-
-                    int order = path_order(path_length, graph_path, recv_path_length, recv_graph_path);
-                    if (order == 1) // recv path >df curr path: update own path, update parent, send DISCOVER to old parent
-                    {
-                        std::copy(recv_graph_path, recv_graph_path + recv_path_length, graph_path);
-                        path_length = recv_path_length;
-
-                        if (!is_parent_rejected)
-                        {
-                            children.insert(parent);                               // old parent becomes child
-                            send_discover(parent, graph_path, path_length, local); // send updated path to old parent
-                        }
-                        parent = status.MPI_SOURCE; // change parent
-                        is_parent_rejected = false;
-                        children.erase(parent); // remove new parent from children
-                    }
-                    else if (order == 0) // curr path \subsetdf recv path: remove sender or t from children, send reject to sender
-                    {
-                        int t = recv_graph_path[path_length]; // link t is the other link that connects p to the loop
-                        if (t < status.MPI_SOURCE)
-                        { // if the path through t is more df, sender needs to be rejected
-                            children.erase(status.MPI_SOURCE);
-                            send_reject(status.MPI_SOURCE, local);
-                        }
-                        else
-                        { // t is rejected
-                            children.erase(t);
-                            send_reject(t, local);
-                        }
-                    }
-                    else if (order == -1)
-                    { // curr path more df than recv path, send path back to sender
-                        send_discover(status.MPI_SOURCE, graph_path, path_length, local);
-                    }
-                }
-                break;
-            }
-        case REJECT_TYPE:
-        {
-            std::cerr << "[" << world_rank << "]:"
-                      << "Got REJECT msg FROM: " << status.MPI_SOURCE << "\t\t" << msgct << std::endl;
-            MPI_Recv(NULL, 0, MPI_INT, status.MPI_SOURCE, REJECT_TYPE, local, MPI_STATUS_IGNORE);
-
-            if (status.MPI_SOURCE == parent)
-            {
-                is_parent_rejected = true;
-            }
-            else
-            {
-                children.erase(status.MPI_SOURCE);
-            }
-            break;
-        }
-        case TERMINATE_TYPE:
-        {
-            std::cerr << "[" << world_rank << "]:"
-                      << "Got TERMINATE msg FROM: " << status.MPI_SOURCE << "\t\t" << msgct << std::endl;
-            MPI_Recv(NULL, 0, MPI_INT, status.MPI_SOURCE, TERMINATE_TYPE, local, MPI_STATUS_IGNORE);
-
-            terminated_children.insert(status.MPI_SOURCE);
-            break;
-        }
-        }
-        std::cerr << "[" << world_rank << "]: "
-                  << " parent: " << parent << " curr-path[" << to_str(path_length, graph_path) << "]"
-                  << " with len:" << std::to_string(path_length) << " children: " << to_arr(children) << " terminated: " << to_arr(terminated_children) << " parent-rejected?: " << is_parent_rejected << std::endl
-                  << std::endl;
-        if (terminated_children.size() == children.size()) // all children have trminated
-        {
-            if (world_rank != 0)
-            {
-                send_terminate(parent, local, world_rank);
-            }
-
-            std::string out = "[" + std::to_string(world_rank) + "]:\t DONE - Children: " + to_arr(children) + "\t\t" + std::to_string(msgct) + "\n";
-            std::cout << out;
-            MPI_Finalize();
-            return 0; // stop the infinite loop and finalise
-        }
+        double load[LOAD_VALUES] = {stats.busy, stats.idle, (double)stats.messages, (double)NeighbourRange(neighbour_row).degree(), (double)state.id};
+        print_imbalance(MPI_COMM_WORLD, 0, load, options.imbalance, stdout);
+    }
+    if (options.report)
+    {
+        MetricsReport report;
+        report.add("messages", stats.messages);
+        report.add("parent_changes", state.parent_changes);
+        report.add("busy_s", stats.busy);
+        report.add("idle_s", stats.idle);
+        phases.add_to(report);
+        if (options.profile)
+            handler_profile().add_to(report);
+        add_page_metrics(report);
+        report.print(MPI_COMM_WORLD, 0, stdout);
     }
+    MPI_Finalize();
+    return 0;
 }
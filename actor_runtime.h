@@ -0,0 +1,461 @@
+/**
+ * Coroutine actor runtime for hosting many vertices in one process
+ * Every actor is a C++20 coroutine that co_awaits its next message, so the logic of a vertex reads as the plain loop of the
+ * MPI version instead of a state machine driven from outside. The actors are split into contiguous blocks, one per thread.
+ * Every thread runs an executor that resumes the actors of its block whose mailbox has mail. A send to an actor of the
+ * same thread appends to its mailbox directly. A send to another thread goes through that executor's locked inbox.
+ *
+ * Per actor the runtime keeps one 32-byte slot (mailbox head and tail, coroutine handle, state). Coroutine frames and
+ * messages come from slab pools owned by the executors, so spawning or messaging an actor does not go through malloc.
+ * Messages keep their payload capacity when they are reused.
+ *
+ * The run ends when every actor has finished, or when the system is quiescent: no message is queued or being handled,
+ * so no actor can ever be resumed again. Messages to finished actors are dropped when they are delivered.
+ *
+ * Requires C++20 (see the pddfs_actors target in CMakeLists.txt).
+ */
+
+#ifndef ACTOR_RUNTIME_H
+#define ACTOR_RUNTIME_H
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#define ACTOR_SLAB_BYTES ((size_t)1 << 20)
+
+/**
+ * Message between actors, the payload is owned by the message and reused with it
+ */
+struct ActorMessage
+{
+    ActorMessage *next = NULL;
+    int source = 0;
+    int type = 0;
+    std::vector<int> payload;
+};
+
+/**
+ * Fixed-size blocks carved from 1 MB slabs, freed blocks are kept on a free list
+ * Not thread-safe: every executor owns one pool and only its thread uses it, blocks may be freed into another pool.
+ * Slabs are released when the pool is destroyed, which the runtime does only after all threads have stopped.
+ */
+class SlabPool
+{
+public:
+    explicit SlabPool(size_t block) : block((block + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1)),
+                                      free_list(NULL), slab_used(ACTOR_SLAB_BYTES) {}
+    ~SlabPool()
+    {
+        for (void *slab : slabs)
+            free(slab);
+    }
+    SlabPool(const SlabPool &) = delete;
+    SlabPool &operator=(const SlabPool &) = delete;
+
+    void *allocate()
+    {
+        if (free_list != NULL)
+        {
+            void *p = free_list;
+            free_list = *(void **)p;
+            return p;
+        }
+        if (slab_used + block > ACTOR_SLAB_BYTES)
+        {
+            slabs.push_back(malloc(std::max(ACTOR_SLAB_BYTES, block)));
+            if (slabs.back() == NULL)
+                throw std::bad_alloc();
+            slab_used = 0;
+        }
+        void *p = (uint8_t *)slabs.back() + slab_used;
+        slab_used += block;
+        return p;
+    }
+
+    void release(void *p)
+    {
+        *(void **)p = free_list;
+        free_list = p;
+    }
+
+    size_t block_size() const { return block; }
+    size_t bytes() const { return slabs.size() * std::max(ACTOR_SLAB_BYTES, block); }
+
+private:
+    size_t block;
+    void *free_list;
+    size_t slab_used;
+    std::vector<void *> slabs;
+};
+
+/**
+ * Pool of coroutine frames of the current thread, frames of one actor function all have the same size
+ */
+class FramePool
+{
+public:
+    void *allocate(size_t size)
+    {
+        size_t block = (size + 2 * alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1); // frame and owner header
+        for (auto &pool : pools)
+            if (pool->block_size() == block)
+                return store_owner(pool->allocate(), pool.get());
+        pools.push_back(std::make_unique<SlabPool>(block));
+        return store_owner(pools.back()->allocate(), pools.back().get());
+    }
+
+    /**
+     * Free a frame into the pool it came from, the frames of one run are all freed before the pools are destroyed
+     */
+    static void release(void *frame)
+    {
+        uint8_t *block = (uint8_t *)frame - alignof(std::max_align_t);
+        (*(SlabPool **)block)->release(block);
+    }
+
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (auto &pool : pools)
+            total += pool->bytes();
+        return total;
+    }
+
+private:
+    static void *store_owner(void *block, SlabPool *pool)
+    {
+        *(SlabPool **)block = pool; // the owning pool sits in front of the frame, so any thread can free it
+        return (uint8_t *)block + alignof(std::max_align_t);
+    }
+
+    std::vector<std::unique_ptr<SlabPool>> pools;
+};
+
+/**
+ * The frame pool that coroutines created on the current thread are allocated from
+ */
+inline FramePool *&current_frame_pool()
+{
+    thread_local FramePool *pool = NULL;
+    return pool;
+}
+
+/**
+ * Return type of an actor coroutine
+ * The actor runs eagerly until its first co_await, and its frame is freed as soon as it returns.
+ */
+struct ActorTask
+{
+    struct promise_type
+    {
+        ActorTask get_return_object() { return ActorTask{std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+
+        static void *operator new(size_t size)
+        {
+            FramePool *pool = current_frame_pool();
+            return pool != NULL ? pool->allocate(size) : ::operator new(size);
+        }
+        static void operator delete(void *frame, size_t)
+        {
+            FramePool::release(frame); // actors are only created inside ActorSystem::spawn, where a pool is set
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+class ActorSystem
+{
+public:
+    /**
+     * @param actors The amount of actors, actor IDs are 0 .. actors - 1
+     * @param threads The amount of executor threads, actors are split into contiguous blocks
+     */
+    ActorSystem(int actors, int threads) : slots(actors), executors(std::max(1, std::min(threads, std::max(1, actors)))),
+                                           block((actors + (int)executors.size() - 1) / (int)executors.size()),
+                                           in_flight(0), finished(0)
+    {
+        for (size_t e = 0; e < executors.size(); e++)
+            executors[e] = std::make_unique<Executor>();
+    }
+
+    ~ActorSystem()
+    {
+        for (Slot &slot : slots)
+            if (slot.state != SLOT_FINISHED && slot.handle)
+                slot.handle.destroy(); // actors that never finished are still suspended in a co_await
+    }
+
+    /**
+     * Create actor id on its executor, the actor runs until its first co_await, call before run()
+     *
+     * @param id The actor
+     * @param body Creates the coroutine, called as body() with the frame pool of the executor set
+     */
+    template <typename F>
+    void spawn(int id, F body)
+    {
+        current = executors[owner(id)].get();
+        current_frame_pool() = &current->frames;
+        current->consumed = 0;
+        slots[id].handle = body().handle;
+        in_flight.fetch_sub(current->consumed); // mail sent by actors spawned earlier
+        current_frame_pool() = NULL;
+    }
+
+    /**
+     * @return A message from the pool of the current executor, its payload is empty
+     */
+    ActorMessage *message()
+    {
+        ActorMessage *m = current->messages.allocate();
+        m->payload.clear();
+        return m;
+    }
+
+    /**
+     * Send a message, ownership passes to the runtime
+     */
+    void send(int dest, ActorMessage *m)
+    {
+        in_flight.fetch_add(1, std::memory_order_relaxed);
+        Executor *target = executors[owner(dest)].get();
+        if (target == current)
+            deliver(dest, m);
+        else
+        {
+            std::lock_guard<std::mutex> lock(target->inbox_lock);
+            target->inbox.push_back(std::make_pair(dest, m));
+            target->inbox_size.store(target->inbox.size(), std::memory_order_release);
+        }
+    }
+
+    /**
+     * Return a handled message to the pool of the current executor
+     */
+    void release(ActorMessage *m) { current->messages.release(m); }
+
+    /**
+     * Awaitable for the next message of an actor, co_await system.receive(id) yields the message
+     */
+    struct Receive
+    {
+        ActorSystem *system;
+        int id;
+
+        bool await_ready() const { return system->slots[id].head != NULL; }
+        void await_suspend(std::coroutine_handle<>) { system->slots[id].state = SLOT_WAITING; }
+        ActorMessage *await_resume()
+        {
+            Slot &slot = system->slots[id];
+            ActorMessage *m = slot.head;
+            slot.head = m->next;
+            if (slot.head == NULL)
+                slot.tail = NULL;
+            system->current->consumed++;
+            return m;
+        }
+    };
+
+    Receive receive(int id) { return Receive{this, id}; }
+
+    /**
+     * Mark an actor as finished, every actor must call this right before it returns
+     */
+    void finish(int id)
+    {
+        Slot &slot = slots[id];
+        slot.state = SLOT_FINISHED;
+        for (ActorMessage *m = slot.head; m != NULL;)
+        {
+            ActorMessage *next = m->next;
+            current->messages.release(m);
+            in_flight.fetch_sub(1, std::memory_order_relaxed);
+            m = next;
+        }
+        slot.head = slot.tail = NULL;
+        finished.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * Run all executors until every actor has finished or no message is left
+     *
+     * @return true if every actor finished
+     */
+    bool run()
+    {
+        std::vector<std::thread> threads;
+        for (size_t e = 1; e < executors.size(); e++)
+            threads.emplace_back([this, e]()
+                                 { run_executor(executors[e].get()); });
+        run_executor(executors[0].get());
+        for (std::thread &t : threads)
+            t.join();
+        return finished.load() == (long)slots.size();
+    }
+
+    long finished_actors() const { return finished.load(); }
+    int threads() const { return (int)executors.size(); }
+
+    /**
+     * @return The bytes of all slabs holding coroutine frames
+     */
+    size_t frame_bytes() const
+    {
+        size_t total = 0;
+        for (auto &executor : executors)
+            total += executor->frames.bytes();
+        return total;
+    }
+
+private:
+    enum SlotState : uint8_t
+    {
+        SLOT_RUNNING, // created or resumed, not waiting
+        SLOT_WAITING, // suspended in co_await receive() on an empty mailbox
+        SLOT_FINISHED
+    };
+
+    struct Slot
+    {
+        ActorMessage *head = NULL;
+        ActorMessage *tail = NULL;
+        std::coroutine_handle<> handle;
+        SlotState state = SLOT_RUNNING;
+    };
+
+    /**
+     * Pool of message nodes, nodes are constructed once and destroyed with the pool
+     */
+    class MessagePool
+    {
+    public:
+        MessagePool() : slabs(sizeof(ActorMessage)) {}
+        ~MessagePool()
+        {
+            for (ActorMessage *m : created)
+                m->~ActorMessage();
+        }
+
+        ActorMessage *allocate()
+        {
+            if (free_list != NULL)
+            {
+                ActorMessage *m = free_list;
+                free_list = m->next;
+                m->next = NULL;
+                return m;
+            }
+            created.push_back(new (slabs.allocate()) ActorMessage());
+            return created.back();
+        }
+
+        void release(ActorMessage *m)
+        {
+            m->next = free_list;
+            free_list = m;
+        }
+
+    private:
+        SlabPool slabs;
+        ActorMessage *free_list = NULL;
+        std::vector<ActorMessage *> created;
+    };
+
+    struct Executor
+    {
+        FramePool frames;
+        MessagePool messages;
+        std::deque<int> ready; // actors with mail to resume
+        long consumed = 0;     // messages taken by the actor being resumed
+        std::mutex inbox_lock; // sends from other executors
+        std::vector<std::pair<int, ActorMessage *>> inbox;
+        std::atomic<size_t> inbox_size{0};
+    };
+
+    int owner(int id) const { return id / block; }
+
+    /**
+     * Append a message to the mailbox of an actor of the current executor, and schedule the actor if it waits
+     */
+    void deliver(int dest, ActorMessage *m)
+    {
+        Slot &slot = slots[dest];
+        if (slot.state == SLOT_FINISHED)
+        {
+            current->messages.release(m);
+            in_flight.fetch_sub(1, std::memory_order_relaxed);
+            return;
+        }
+        m->next = NULL;
+        if (slot.tail != NULL)
+            slot.tail->next = m;
+        else
+            slot.head = m;
+        slot.tail = m;
+        if (slot.state == SLOT_WAITING)
+        {
+            slot.state = SLOT_RUNNING;
+            current->ready.push_back(dest);
+        }
+    }
+
+    void run_executor(Executor *executor)
+    {
+        current = executor;
+        current_frame_pool() = &executor->frames;
+        std::vector<std::pair<int, ActorMessage *>> arrived;
+        while (true)
+        {
+            if (executor->inbox_size.load(std::memory_order_acquire) > 0)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(executor->inbox_lock);
+                    arrived.swap(executor->inbox);
+                    executor->inbox_size.store(0, std::memory_order_relaxed);
+                }
+                for (auto &mail : arrived)
+                    deliver(mail.first, mail.second);
+                arrived.clear();
+            }
+            if (executor->ready.empty())
+            {
+                // every message is counted until the actor that takes it has been suspended again, so 0 means no actor runs or can run
+                if (finished.load(std::memory_order_relaxed) == (long)slots.size() || in_flight.load() == 0)
+                    break;
+                std::this_thread::yield();
+                continue;
+            }
+            int id = executor->ready.front();
+            executor->ready.pop_front();
+            executor->consumed = 0;
+            slots[id].handle.resume();
+            in_flight.fetch_sub(executor->consumed);
+        }
+        current_frame_pool() = NULL;
+    }
+
+    std::vector<Slot> slots;
+    std::vector<std::unique_ptr<Executor>> executors;
+    int block; // actors per executor
+    std::atomic<long> in_flight;
+    std::atomic<long> finished;
+    static inline thread_local Executor *current = NULL; // the executor of the current thread
+};
+
+#endif
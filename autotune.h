@@ -0,0 +1,220 @@
+/**
+ * Startup tuning of the PDDFS run from the loaded graph
+ * With --autotune, rank 0 profiles the graph right after reading it (size, density, degree skew) together with the amount of
+ * machines the processes run on, and picks the vertex ordering (--order) from a policy table: the first rule whose bounds
+ * all hold wins. With --autotune cut the ordering is chosen by a trial instead: every candidate ordering is applied to the
+ * graph and the one that places the fewest edges between processes on different machines wins, those edges carry the
+ * messages that leave shared memory. With --pin the NUMA nodes of a machine count as machines of their own, a message
+ * between processes on different nodes crosses the socket interconnect. Unless --hugepages is given, both modes also choose
+ * the huge page mode from the kernel before the graph is loaded (see tune_pages()).
+ *
+ * The default table is a starting point, not a measured result: it assumes that within one NUMA node the placement does
+ * not change the message cost, that dense graphs cut almost every edge under any ordering, and that skewed degree
+ * distributions profit from the degree rules of RCM. Check it against bench/run_benchmarks.sh on the target machines.
+ * --autotune-policy <file> replaces the table, one rule per line, 0 for a bound that always holds, '#' starts a comment:
+ *   <max vertices> <max machines> <min density> <min degree skew> <order: none|bfs|rcm>
+ * Degree skew is the largest degree divided by the mean degree. A table without a matching rule keeps --order.
+ */
+
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "compressed_adjacency.h"
+#include "large_pages.h"
+#include "reorder.h"
+
+enum TuneMode
+{
+    TUNE_OFF,
+    TUNE_POLICY,
+    TUNE_CUT
+};
+
+/**
+ * What the tuner looks at
+ */
+struct GraphProfile
+{
+    int vertices = 0;
+    long edges = 0; // undirected, every edge is stored in both directions
+    double density = 0;
+    double skew = 0; // largest degree / mean degree
+    int machines = 1; // with --pin every NUMA node counts as a machine
+};
+
+/**
+ * @param graph The loaded graph
+ * @param machine machine[r] is the machine of rank r
+ */
+inline GraphProfile profile_graph(const AdjacencyView &graph, const std::vector<int> &machine)
+{
+    GraphProfile profile;
+    long entries = 0;
+    uint32_t max_degree = 0;
+    for (int v = 0; v < graph.n; v++)
+    {
+        entries += graph.degree(v);
+        max_degree = std::max(max_degree, graph.degree(v));
+    }
+    profile.vertices = graph.n;
+    profile.edges = entries / 2;
+    profile.density = graph.n > 1 ? (double)entries / ((double)graph.n * (graph.n - 1)) : 0;
+    profile.skew = entries > 0 ? max_degree / ((double)entries / graph.n) : 0;
+    profile.machines = machine.empty() ? 1 : *std::max_element(machine.begin(), machine.end()) + 1;
+    return profile;
+}
+
+/**
+ * One row of the policy table, bounds of 0 always hold
+ */
+struct TuneRule
+{
+    int max_vertices;
+    int max_machines;
+    double min_density;
+    double min_skew;
+    VertexOrder order;
+
+    bool matches(const GraphProfile &p) const
+    {
+        return (max_vertices == 0 || p.vertices <= max_vertices) && (max_machines == 0 || p.machines <= max_machines) &&
+               p.density >= min_density && p.skew >= min_skew;
+    }
+};
+
+inline std::vector<TuneRule> default_tune_policy()
+{
+    return {
+        {0, 1, 0, 0, ORDER_NONE},   // one machine or NUMA node: every message costs the same
+        {0, 0, 0.1, 0, ORDER_NONE}, // dense: every ordering cuts most edges, ordering is not worth its time
+        {0, 0, 0, 8, ORDER_RCM},    // skewed degrees: RCM visits hubs last and keeps their neighbourhoods together
+        {0, 0, 0, 0, ORDER_BFS},
+    };
+}
+
+/**
+ * The tuning requested on the command line
+ */
+struct TuneSettings
+{
+    TuneMode mode = TUNE_OFF;
+    std::vector<TuneRule> policy = default_tune_policy();
+    bool numa = false; // count NUMA nodes as machines, only stable when the processes are pinned
+};
+
+/**
+ * Read a policy table, see the file comment for the format
+ *
+ * @return false if the file cannot be read or a rule is malformed
+ */
+inline bool read_tune_policy(const char *path, std::vector<TuneRule> *policy)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    policy->clear();
+    std::string line;
+    while (std::getline(in, line))
+    {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        TuneRule rule;
+        std::string order;
+        if (!(fields >> rule.max_vertices))
+            continue; // blank or comment line
+        if (!(fields >> rule.max_machines >> rule.min_density >> rule.min_skew >> order) || !parse_vertex_order(order, &rule.order))
+            return false;
+        policy->push_back(rule);
+    }
+    return true;
+}
+
+/**
+ * Count the edges whose endpoints are hosted on different machines
+ *
+ * @param graph The graph
+ * @param order The hosting order, order[r] is the vertex on rank r, empty for the identity
+ * @param machine machine[r] is the machine of rank r
+ */
+inline long cross_machine_edges(const AdjacencyView &graph, const std::vector<int> &order, const std::vector<int> &machine)
+{
+    VertexIds ids;
+    if (!order.empty())
+        ids.assign(order);
+    long cut = 0;
+    for (int v = 0; v < graph.n; v++)
+        for (int w : graph.neighbours(v))
+            if (w < graph.n && machine[ids.rank_of(v)] != machine[ids.rank_of(w)])
+                cut++;
+    return cut / 2;
+}
+
+inline const char *order_name(VertexOrder order)
+{
+    return order == ORDER_BFS ? "bfs" : order == ORDER_RCM ? "rcm" : "none";
+}
+
+/**
+ * Choose the ordering on rank 0
+ *
+ * @param graph The loaded graph
+ * @param machine machine[r] is the machine of rank r
+ * @param mode TUNE_POLICY or TUNE_CUT
+ * @param policy The policy table for TUNE_POLICY
+ * @param order The ordering, kept if no rule matches
+ * @param out The TUNE line is printed here
+ */
+inline void tune_order(const AdjacencyView &graph, const std::vector<int> &machine, TuneMode mode, const std::vector<TuneRule> &policy,
+                       VertexOrder *order, FILE *out)
+{
+    GraphProfile profile = profile_graph(graph, machine);
+    fprintf(out, "TUNE vertices %d edges %ld density %.4g skew %.2f machines %d", profile.vertices, profile.edges, profile.density,
+            profile.skew, profile.machines);
+    if (mode == TUNE_CUT)
+    {
+        long best = -1;
+        for (VertexOrder candidate : {ORDER_NONE, ORDER_BFS, ORDER_RCM}) // cheapest ordering first, so it wins ties
+        {
+            long cut = cross_machine_edges(graph, vertex_order(graph, candidate), machine);
+            fprintf(out, " cut_%s %ld", order_name(candidate), cut);
+            if (best < 0 || cut < best)
+            {
+                best = cut;
+                *order = candidate;
+            }
+        }
+    }
+    else
+        for (const TuneRule &rule : policy)
+            if (rule.matches(profile))
+            {
+                *order = rule.order;
+                break;
+            }
+    fprintf(out, " order %s pages %s\n", order_name(*order), large_pages().mode == PAGES_DEFAULT ? "default" : large_pages().mode == PAGES_TRANSPARENT ? "transparent" : "explicit");
+}
+
+/**
+ * Choose the huge page mode, called before anything is allocated through large_pages.h
+ * Only allocations of at least a large page use huge pages (the adjacency on rank 0, the path buffers of large graphs),
+ * smaller ones stay on malloc in every mode, so the choice depends on the kernel and not on the graph. In madvise mode the
+ * kernel only backs the ranges alloc_large() marks, in always mode it already backs large anonymous ranges and in never
+ * mode it ignores the advice.
+ *
+ * @return Transparent huge pages when the kernel only uses them for advised ranges
+ */
+inline LargePageMode tune_pages()
+{
+    std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string setting;
+    std::getline(in, setting);
+    return setting.find("[madvise]") != std::string::npos ? PAGES_TRANSPARENT : PAGES_DEFAULT;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#!/bin/bash
+# Two-stage profile-guided build of the PDDFS binaries
+#   1. build instrumented binaries and run the training workload (bench/run_benchmarks.sh)
+#   2. rebuild the same build directory with the collected profile (and LTO)
+# Both stages use one build directory: GCC names profile files after the object file paths.
+# Extra arguments are passed to both cmake configure steps.
+#
+# usage: bench/pgo_build.sh [build dir (default build)] [cmake options]
+
+set -eu
+cd "$(dirname "$0")/.."
+
+build=${1:-build}
+shift || true
+case "$build" in
+/*) profile="$build-pgo-profile" ;;
+*) profile="$(pwd)/$build-pgo-profile" ;;
+esac
+
+rm -rf "$profile"
+cmake -S . -B "$build" -DPDDFS_PGO=GENERATE -DPDDFS_PGO_DIR="$profile" -DPDDFS_LTO=OFF "$@"
+cmake --build "$build" -j"$(nproc)"
+cmake --build "$build" --target pgo-train
+if [ -z "$(find "$profile" -name '*.gcda' -o -name '*.profraw' | head -n 1)" ]; then
+    echo "the training workload wrote no profile to $profile, not building the USE stage" >&2
+    exit 1
+fi
+
+cmake -S . -B "$build" -DPDDFS_PGO=USE -DPDDFS_PGO_DIR="$profile" -DPDDFS_LTO=ON "$@"
+cmake --build "$build" -j"$(nproc)"
@@ -0,0 +1,103 @@
+#!/bin/bash
+# Benchmark harness for the PDDFS algorithm
+# Runs every scenario a number of times and stores one row per repetition in
+#   bench/results/<commit>/<machine>.tsv
+# as "scenario <tab> metric <tab> value". Two result files are compared with bench_compare.
+#
+# Scenarios, separated by spaces:
+#   tree:<vertices>:<extra edges>:<seed>       a random tree plus extra edges from tree_gen
+#   er:<vertices>:<probability>:<seed>         an Erdos-Renyi graph from erdos_renyi_gen ("<vertices>:<probability>:<seed>" too)
+#   file:<edge list>                           a graph from a file, one process per vertex
+# The protocol does not converge on every graph with cycles (see the README), so the default scenarios are trees, on which
+# it always terminates, and tests/cycles.txt, which the ctest checks run on every transport. Erdos-Renyi graphs stall or
+# hang on many seeds. The graphs must be connected: a vertex that is never discovered never terminates.
+# Per run the wall time of mpirun, the total message count and the peak memory (from the --report metrics) are stored, and
+# a "failed" row that is 0 for a finished run and 1 for a run that failed or hit RUN_TIMEOUT, whose other metrics are
+# not recorded. bench_compare reports the failed runs of every scenario next to the medians of the finished ones.
+# The microbenchmarks are run as well unless --no-micro is given.
+#
+# usage: bench/run_benchmarks.sh [--reps <n>] [--bin-dir <dir>] [--out <dir>] [--no-micro] [-- <extra solver options>]
+# environment: SCENARIOS, MPIRUN (default mpirun), MPIRUN_FLAGS (default none), RUN_TIMEOUT (seconds, default 60)
+# The scenarios start more processes than most machines have cores, which some MPI implementations refuse by default:
+# with Open MPI set MPIRUN_FLAGS=--oversubscribe, MPICH and Intel MPI oversubscribe without a flag.
+
+set -u
+cd "$(dirname "$0")/.."
+
+reps=5
+bin_dir=build
+out_dir=bench/results
+micro=1
+solver_args=()
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --reps) reps=$2; shift 2 ;;
+    --bin-dir) bin_dir=$2; shift 2 ;;
+    --out) out_dir=$2; shift 2 ;;
+    --no-micro) micro=0; shift ;;
+    --) shift; solver_args=("$@"); break ;;
+    *) echo "unknown option $1" >&2; exit 1 ;;
+    esac
+done
+
+scenarios=${SCENARIOS:-"tree:16:0:1 tree:32:0:1 tree:64:0:1 file:tests/cycles.txt"}
+mpirun=${MPIRUN:-mpirun}
+mpirun_flags=${MPIRUN_FLAGS:-}
+run_timeout=${RUN_TIMEOUT:-60}
+
+commit=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if ! git diff --quiet HEAD 2>/dev/null; then
+    commit="$commit-dirty"
+fi
+machine=$(hostname -s)
+mkdir -p "$out_dir/$commit"
+result="$out_dir/$commit/$machine.tsv"
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+echo "# commit $commit machine $machine date $(date -u +%Y-%m-%dT%H:%M:%SZ) solver_args ${solver_args[*]:-}" > "$result"
+
+for scenario in $scenarios; do
+    IFS=: read -r kind a b c <<< "$scenario"
+    case "$kind" in
+    tree)
+        name="tree/n=$a/extra=$b/seed=$c"
+        "$bin_dir/tree_gen" "$a" "$b" "$c" > "$work/graph.txt" ;;
+    er)
+        name="er/n=$a/p=$b/seed=$c"
+        "$bin_dir/erdos_renyi_gen" "$a" "$b" "$c" > "$work/graph.txt" ;;
+    file)
+        name="file/$(basename "$a")"
+        cp "$a" "$work/graph.txt" ;;
+    *)
+        name="er/n=$kind/p=$a/seed=$b"
+        "$bin_dir/erdos_renyi_gen" "$kind" "$a" "$b" > "$work/graph.txt" ;;
+    esac
+    n=$(awk 'NF >= 2 && $1 + 1 > n { n = $1 + 1 } NF >= 2 && $2 + 1 > n { n = $2 + 1 } END { print n + 0 }' "$work/graph.txt")
+    for rep in $(seq "$reps"); do
+        start=$(date +%s.%N)
+        timeout -k 5 "$run_timeout" $mpirun $mpirun_flags -np "$n" "$bin_dir/pddfs" --report "${solver_args[@]}" < "$work/graph.txt" > "$work/run.txt" 2> /dev/null
+        status=$?
+        end=$(date +%s.%N)
+        if [ $status -ne 0 ]; then
+            case $status in
+            124 | 137) reason="timed out after ${run_timeout}s" ;;
+            *) reason="exit $status" ;;
+            esac
+            echo "$name repetition $rep failed ($reason)" >&2
+            printf "%s\tfailed\t1\n" "$name" >> "$result"
+            continue
+        fi
+        printf "%s\tfailed\t0\n" "$name" >> "$result"
+        awk -v name="$name" -v start="$start" -v end="$end" 'BEGIN { printf "%s\twall_s\t%.6f\n", name, end - start }' >> "$result"
+        awk -v name="$name" '$1 == "METRIC" && $2 == "messages" { printf "%s\tmessages\t%s\n", name, $6 }
+                             $1 == "METRIC" && $2 == "max_rss_kb" { printf "%s\tmax_rss_kb\t%s\n", name, $4 }' "$work/run.txt" >> "$result"
+    done
+    echo "$name done" >&2
+done
+
+if [ $micro -eq 1 ]; then
+    $mpirun $mpirun_flags -np 2 "$bin_dir/pddfs_microbench" --tsv --reps "$reps" >> "$result" 2> /dev/null
+fi
+
+echo "results written to $result" >&2
@@ -0,0 +1,202 @@
+/**
+* Compare two benchmark result files written by bench/run_benchmarks.sh
+* For every scenario and metric present in both files the medians are compared, and a two-sided Mann-Whitney U test
+* over the repetitions decides whether the difference is significant. For all metrics lower is better.
+* A change is flagged as REGRESSION when the median got worse by more than the threshold and the test is significant.
+* The "failed" metric of the harness (1 for a repetition that failed or timed out, 0 otherwise) is not compared by its
+* median: the failed repetitions are counted instead, and a scenario that fails more often than in the baseline is
+* flagged as MORE_FAILURES and counts as a regression. The other metrics of such a scenario only cover the finished runs.
+* The program exits with status 1 when a regression is found, so it can gate a CI job.
+*
+* usage: bench_compare <baseline.tsv> <candidate.tsv> [--threshold <percent>] [--alpha <p>]
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+typedef map<pair<string, string>, vector<double>> Results;
+
+/**
+ * Read a result file, lines starting with '#' are comments
+ *
+ * @return false if the file cannot be opened
+ */
+bool read_results(const char *path, Results &results)
+{
+    ifstream in(path);
+    if (!in)
+        return false;
+    string line;
+    while (getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        string scenario, metric;
+        double value;
+        if (getline(fields, scenario, '\t') && getline(fields, metric, '\t') && fields >> value)
+            results[make_pair(scenario, metric)].push_back(value);
+    }
+    return true;
+}
+
+double median(vector<double> values)
+{
+    sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+/**
+ * Two-sided p-value of the Mann-Whitney U test
+ * Small samples without ties use the exact distribution of U, otherwise the normal approximation with tie correction.
+ */
+double mann_whitney_p(const vector<double> &a, const vector<double> &b)
+{
+    int n1 = a.size(), n2 = b.size(), n = n1 + n2;
+    vector<pair<double, int>> all;
+    for (double x : a)
+        all.push_back(make_pair(x, 0));
+    for (double x : b)
+        all.push_back(make_pair(x, 1));
+    sort(all.begin(), all.end());
+
+    double rank_sum = 0, tie_term = 0;
+    bool ties = false;
+    for (int i = 0; i < n;)
+    {
+        int j = i;
+        while (j < n && all[j].first == all[i].first)
+            j++;
+        double rank = (i + j + 1) / 2.0; // average of ranks i+1 .. j
+        for (int k = i; k < j; k++)
+            if (all[k].second == 0)
+                rank_sum += rank;
+        double t = j - i;
+        tie_term += t * t * t - t;
+        ties |= t > 1;
+        i = j;
+    }
+    double u = rank_sum - n1 * (n1 + 1) / 2.0;
+
+    if (!ties && n1 <= 20 && n2 <= 20)
+    {
+        // count[i][j][k]: arrangements of i values of a and j values of b with U = k
+        int max_u = n1 * n2;
+        vector<vector<vector<double>>> count(n1 + 1, vector<vector<double>>(n2 + 1, vector<double>(max_u + 1, 0)));
+        for (int i = 0; i <= n1; i++)
+            for (int j = 0; j <= n2; j++)
+                for (int k = 0; k <= max_u; k++)
+                {
+                    if (i == 0 || j == 0)
+                        count[i][j][k] = k == 0;
+                    else
+                        count[i][j][k] = (k >= j ? count[i - 1][j][k - j] : 0) + count[i][j - 1][k];
+                }
+        double total = 0, below = 0, above = 0;
+        for (int k = 0; k <= max_u; k++)
+        {
+            total += count[n1][n2][k];
+            if (k <= u)
+                below += count[n1][n2][k];
+            if (k >= u)
+                above += count[n1][n2][k];
+        }
+        return min(1.0, 2 * min(below, above) / total);
+    }
+
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / ((double)n * (n - 1)));
+    if (variance <= 0)
+        return 1;
+    double z = (fabs(u - mean) - 0.5) / sqrt(variance);
+    return min(1.0, erfc(max(0.0, z) / sqrt(2.0)));
+}
+
+int main(int argc, char *argv[])
+{
+    double threshold = 5, alpha = 0.05;
+    vector<const char *> files;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--threshold" && i + 1 < argc)
+            threshold = stod(argv[++i]);
+        else if (arg == "--alpha" && i + 1 < argc)
+            alpha = stod(argv[++i]);
+        else
+            files.push_back(argv[i]);
+    }
+    if (files.size() != 2)
+    {
+        cerr << "usage: " << argv[0] << " <baseline.tsv> <candidate.tsv> [--threshold <percent>] [--alpha <p>]" << endl;
+        return 2;
+    }
+    Results baseline, candidate;
+    for (int i = 0; i < 2; i++)
+        if (!read_results(files[i], i == 0 ? baseline : candidate))
+        {
+            cerr << "cannot read " << files[i] << endl;
+            return 2;
+        }
+
+    printf("%-48s %-12s %12s %12s %9s %8s  %s\n", "scenario", "metric", "baseline", "candidate", "delta%", "p", "verdict");
+    int regressions = 0, failing = 0;
+    for (auto &entry : baseline)
+    {
+        auto other = candidate.find(entry.first);
+        if (other == candidate.end())
+            continue;
+        if (entry.first.second == "failed")
+        {
+            double failed_before = 0, failed_after = 0;
+            for (double x : entry.second)
+                failed_before += x;
+            for (double x : other->second)
+                failed_after += x;
+            if (failed_before == 0 && failed_after == 0)
+                continue;
+            failing++;
+            double rate_before = failed_before / entry.second.size(), rate_after = failed_after / other->second.size();
+            const char *verdict = "~";
+            if (rate_after > rate_before)
+            {
+                verdict = "MORE_FAILURES";
+                regressions++;
+            }
+            else if (rate_after < rate_before)
+                verdict = "fewer failures";
+            string before = to_string((int)failed_before) + "/" + to_string(entry.second.size());
+            string after = to_string((int)failed_after) + "/" + to_string(other->second.size());
+            printf("%-48s %-12s %12s %12s %9s %8s  %s\n", entry.first.first.c_str(), "failed", before.c_str(), after.c_str(), "", "", verdict);
+            continue;
+        }
+        double before = median(entry.second), after = median(other->second);
+        double delta = before != 0 ? (after - before) / fabs(before) * 100 : 0;
+        double p = mann_whitney_p(entry.second, other->second);
+        const char *verdict = "~";
+        if (p < alpha && delta > threshold)
+        {
+            verdict = "REGRESSION";
+            regressions++;
+        }
+        else if (p < alpha && delta < -threshold)
+            verdict = "improved";
+        printf("%-48s %-12s %12.4g %12.4g %+9.2f %8.4f  %s\n", entry.first.first.c_str(), entry.first.second.c_str(),
+               before, after, delta, p, verdict);
+    }
+    if (failing > 0)
+        printf("%d scenario(s) with failed runs, their medians only cover the finished runs\n", failing);
+    printf("%d regression(s) beyond %.1f%% at alpha %.3f\n", regressions, threshold, alpha);
+    return regressions > 0;
+}
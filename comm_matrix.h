@@ -0,0 +1,138 @@
+/**
+ * Communication matrix of a PDDFS run
+ * With --comm-matrix <file> every process counts the messages and bytes it sends per destination and message type.
+ * After the run the root gathers the counts and writes them as a sparse matrix, one line per non-zero entry:
+ *   <source rank> <destination rank> <source vertex> <destination vertex> <type> <messages> <bytes>
+ * Vertices are original IDs, so the file can be fed to a partitioner regardless of the --order used for the run.
+ * With --comm-nodes the matrix is also coarsened to machines and written to <file>.nodes as
+ * <source node> <destination node> <messages> <bytes> lines, summed over all types. Machines are those of machine_of_ranks()
+ * (placement.h), the same the tuner counts cut edges on: processes sharing memory, and with --pin every NUMA node apart.
+ */
+
+#ifndef COMM_MATRIX_H
+#define COMM_MATRIX_H
+
+#include <mpi.h>
+#include <array>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "placement.h"
+#include "reorder.h"
+
+#define COMM_TYPES 3 // DISCOVER, REJECT, TERMINATE, indexed by message type - 1
+
+/**
+ * Process-wide send counts, messages per type followed by bytes per type for every destination rank
+ */
+struct CommMatrix
+{
+    bool enabled = false;
+    std::map<int, std::array<long, 2 * COMM_TYPES>> rows;
+};
+
+inline CommMatrix &comm_matrix()
+{
+    static CommMatrix matrix;
+    return matrix;
+}
+
+/**
+ * Count a sent message, does nothing when the matrix is not recorded
+ *
+ * @param dest_rank The rank the message is sent to
+ * @param type The message type
+ * @param ints The size of the message in ints
+ */
+inline void count_send(int dest_rank, int type, int ints)
+{
+    CommMatrix &matrix = comm_matrix();
+    if (!matrix.enabled)
+        return;
+    std::array<long, 2 * COMM_TYPES> &row = matrix.rows[dest_rank]; // value-initialised to zeros on first use
+    row[type - 1]++;
+    row[COMM_TYPES + type - 1] += ints * (long)sizeof(int);
+}
+
+/**
+ * Gather the counts of all processes and write the matrix files on the root, collective
+ *
+ * @param comm The communicator the counted ranks belong to
+ * @param root The process that writes the files
+ * @param path The matrix file, the node view is written to path + ".nodes"
+ * @param ids Translation from ranks to original vertex IDs
+ * @param nodes Also write the node view
+ * @param numa Count every NUMA node as a node of its own in the node view, see machine_of_ranks()
+ * @return false on the root if a file cannot be written
+ */
+inline bool write_comm_matrix(MPI_Comm comm, int root, const char *path, const VertexIds &ids, bool nodes, bool numa = false)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // entries of the current process: destination, type, messages, bytes
+    std::vector<long> entries;
+    for (auto &row : comm_matrix().rows)
+        for (int t = 0; t < COMM_TYPES; t++)
+            if (row.second[t] > 0)
+            {
+                long entry[4] = {row.first, t + 1, row.second[t], row.second[COMM_TYPES + t]};
+                entries.insert(entries.end(), entry, entry + 4);
+            }
+    int count = (int)entries.size();
+    std::vector<int> counts(rank == root ? size : 0), displs(rank == root ? size : 0);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, root, comm);
+    std::vector<long> all;
+    if (rank == root)
+    {
+        for (int r = 1; r < size; r++)
+            displs[r] = displs[r - 1] + counts[r - 1];
+        all.resize(displs[size - 1] + counts[size - 1]);
+    }
+    MPI_Gatherv(entries.data(), count, MPI_LONG, all.data(), counts.data(), displs.data(), MPI_LONG, root, comm);
+
+    std::vector<int> machine; // node of every rank, numbered in the order of their first rank
+    if (nodes)
+        machine = machine_of_ranks(comm, root, numa);
+    if (rank != root)
+        return true;
+
+    FILE *out = fopen(path, "w");
+    if (out == NULL)
+        return false;
+    fprintf(out, "# source_rank dest_rank source_vertex dest_vertex type messages bytes\n");
+    for (int r = 0; r < size; r++)
+        for (int i = displs[r]; i < displs[r] + counts[r]; i += 4)
+            fprintf(out, "%d %ld %d %d %ld %ld %ld\n", r, all[i], ids.original_id(r), ids.original_id((int)all[i]), all[i + 1], all[i + 2], all[i + 3]);
+    bool ok = fclose(out) == 0;
+    if (!nodes)
+        return ok;
+
+    std::vector<int> first_rank; // of every node
+    for (int r = 0; r < size; r++)
+        if (machine[r] == (int)first_rank.size())
+            first_rank.push_back(r);
+    std::map<std::pair<int, int>, std::pair<long, long>> coarse;
+    for (int r = 0; r < size; r++)
+        for (int i = displs[r]; i < displs[r] + counts[r]; i += 4)
+        {
+            std::pair<long, long> &cell = coarse[std::make_pair(machine[r], machine[all[i]])];
+            cell.first += all[i + 2];
+            cell.second += all[i + 3];
+        }
+    out = fopen((std::string(path) + ".nodes").c_str(), "w");
+    if (out == NULL)
+        return false;
+    fprintf(out, "# %d nodes, node n starts at rank:", (int)first_rank.size());
+    for (int r : first_rank)
+        fprintf(out, " %d", r);
+    fprintf(out, "\n# source_node dest_node messages bytes\n");
+    for (auto &cell : coarse)
+        fprintf(out, "%d %d %ld %ld\n", cell.first.first, cell.first.second, cell.second.first, cell.second.second);
+    return fclose(out) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,426 @@
+/**
+ * Gap-coded compressed adjacency for the PDDFS graph loader
+ * Every row (the neighbour list of one vertex) is stored as a sequence of variable-length bytes (LEB128):
+ * first the degree of the vertex (shifted left by one, the low bit marks a keyed row), then the smallest neighbour, then the
+ * gaps between consecutive sorted neighbours. A keyed row is followed by the ordering key of every neighbour, in neighbour order.
+ * Keys are optional per edge list and rank the neighbours for the DFS: the lower key is explored first (see NeighbourTable).
+ * A per-vertex offset table points to the start of each row, so a single row can be decoded without touching the others.
+ * For the sparse, locally clustered graphs we run on this takes 1-2 bytes per edge instead of 4 (or 8 with a separate source array).
+ *
+ * The same layout is used in memory (CompressedAdjacency) and on disk (see mapped_csr.h), both are read through AdjacencyView.
+ */
+
+#ifndef COMPRESSED_ADJACENCY_H
+#define COMPRESSED_ADJACENCY_H
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+#include "large_pages.h"
+
+/**
+ * Append an unsigned value as LEB128 variable-length bytes
+ *
+ * @param out The byte buffer that is appended to
+ * @param value The value to encode, 7 bits per byte with the high bit as continuation flag
+ */
+template <typename Bytes>
+inline void varint_put(Bytes &out, uint32_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back((uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back((uint8_t)value);
+}
+
+/**
+ * Decode one LEB128 value
+ *
+ * @param pos Pointer to the first byte of the value
+ * @param value Written with the decoded value
+ * @return Pointer to the first byte after the value
+ */
+inline const uint8_t *varint_get(const uint8_t *pos, uint32_t *value)
+{
+    uint32_t byte = *pos++;
+    uint32_t result = byte & 0x7f;
+    int shift = 7;
+    while (byte & 0x80)
+    {
+        byte = *pos++;
+        result |= (byte & 0x7f) << shift;
+        shift += 7;
+    }
+    *value = result;
+    return pos;
+}
+
+/**
+ * Decode one LEB128 value that has to end before a bound
+ *
+ * @param pos Pointer to the first byte of the value
+ * @param end The first byte the value may not use
+ * @param value Written with the decoded value
+ * @return Pointer to the first byte after the value, NULL if the value runs into end or does not fit 32 bits
+ */
+inline const uint8_t *varint_get_bounded(const uint8_t *pos, const uint8_t *end, uint32_t *value)
+{
+    uint64_t result = 0;
+    for (int shift = 0; pos < end && shift < 35; shift += 7)
+    {
+        uint8_t byte = *pos++;
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *value = (uint32_t)result;
+            return result > UINT32_MAX ? NULL : pos;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Check that a row decodes within its own bytes before it is decoded, for rows from an untrusted source (mapped_csr.h):
+ * every value ends inside the row, the neighbours are strictly increasing and smaller than n, a keyed row holds a key
+ * (at most INT_MAX) per neighbour, and nothing follows
+ *
+ * @param row Pointer to the first byte of the row
+ * @param size The bytes of the row
+ * @param n The amount of vertices of the graph
+ */
+inline bool valid_row(const uint8_t *row, uint64_t size, int n)
+{
+    const uint8_t *end = row + size;
+    uint32_t header, value;
+    if ((row = varint_get_bounded(row, end, &header)) == NULL)
+        return false;
+    uint64_t current = 0;
+    for (uint32_t i = 0; i < header >> 1; i++)
+    {
+        if ((row = varint_get_bounded(row, end, &value)) == NULL || (i > 0 && value == 0))
+            return false;
+        current = i == 0 ? value : current + value;
+        if (current >= (uint64_t)n)
+            return false;
+    }
+    if (header & 1)
+        for (uint32_t i = 0; i < header >> 1; i++)
+            if ((row = varint_get_bounded(row, end, &value)) == NULL || value > INT_MAX)
+                return false;
+    return row == end;
+}
+
+/**
+ * Forward iterator that decodes the neighbours of one row on the fly
+ */
+class NeighbourIterator
+{
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef int value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const int *pointer;
+    typedef int reference;
+
+    NeighbourIterator(const uint8_t *pos, uint32_t remaining) : pos(pos), remaining(remaining), current(0), first(true)
+    {
+        advance();
+    }
+
+    int operator*() const { return (int)current; }
+
+    NeighbourIterator &operator++()
+    {
+        remaining--;
+        advance();
+        return *this;
+    }
+
+    bool operator==(const NeighbourIterator &other) const { return remaining == other.remaining; }
+    bool operator!=(const NeighbourIterator &other) const { return remaining != other.remaining; }
+
+private:
+    void advance()
+    {
+        if (remaining == 0)
+            return;
+        uint32_t gap;
+        pos = varint_get(pos, &gap);
+        current = first ? gap : current + gap;
+        first = false;
+    }
+
+    const uint8_t *pos;
+    uint32_t remaining;
+    uint32_t current;
+    bool first;
+};
+
+/**
+ * The neighbours of one vertex, usable in a range-based for loop
+ */
+class NeighbourRange
+{
+public:
+    /**
+     * @param row Pointer to the first byte of an encoded row (the degree)
+     */
+    explicit NeighbourRange(const uint8_t *row)
+    {
+        body = varint_get(row, &count);
+        keyed_ = count & 1;
+        count >>= 1;
+    }
+
+    uint32_t degree() const { return count; }
+    bool keyed() const { return keyed_; }
+    NeighbourIterator begin() const { return NeighbourIterator(body, count); }
+    NeighbourIterator end() const { return NeighbourIterator(body, 0); }
+
+    /**
+     * @return Pointer to the first ordering key of a keyed row, the keys follow the gaps in neighbour order
+     */
+    const uint8_t *keys() const
+    {
+        const uint8_t *pos = body;
+        uint32_t gap;
+        for (uint32_t i = 0; i < count; i++)
+            pos = varint_get(pos, &gap);
+        return pos;
+    }
+
+private:
+    const uint8_t *body;
+    uint32_t count;
+    bool keyed_;
+};
+
+/**
+ * Read-only view on a compressed adjacency, either owned in memory or mapped from disk
+ * Row v occupies bytes[offsets[v] .. offsets[v + 1])
+ */
+struct AdjacencyView
+{
+    int n;
+    const uint64_t *offsets;
+    const uint8_t *bytes;
+
+    NeighbourRange neighbours(int v) const { return NeighbourRange(bytes + offsets[v]); }
+    uint32_t degree(int v) const { return neighbours(v).degree(); }
+    uint64_t row_size(int v) const { return offsets[v + 1] - offsets[v]; }
+
+    /**
+     * @return The largest vertex ID of the graph, either a vertex with a row or a neighbour, -1 for an empty graph
+     */
+    int max_vertex() const
+    {
+        int largest = n - 1;
+        for (int v = 0; v < n; v++)
+            for (int w : neighbours(v))
+                largest = std::max(largest, w);
+        return largest;
+    }
+
+    /**
+     * @return true if the rows carry ordering keys, every row with neighbours of one graph agrees
+     */
+    bool keyed() const
+    {
+        for (int v = 0; v < n; v++)
+            if (degree(v) > 0)
+                return neighbours(v).keyed();
+        return false;
+    }
+};
+
+/**
+ * Builder and owner of a compressed adjacency
+ * Rows are appended in vertex order, vertices that are skipped get an empty row
+ * Both arrays can be backed by huge pages (see large_pages.h)
+ */
+class CompressedAdjacency
+{
+public:
+    CompressedAdjacency() : offsets(1, 0), keyed(false) {}
+
+    /**
+     * Append the row of vertex v
+     *
+     * @param v The vertex, must be larger than the last vertex that was added
+     * @param neighbours The neighbours of v in any order, sorted and deduplicated in place
+     * @param keys The ordering key of every neighbour (non-negative), only stored when the adjacency is keyed,
+     *             NULL gives every neighbour key 0. A duplicate neighbour keeps its lowest key. Permuted with the neighbours.
+     */
+    void add_row(int v, std::vector<int> &neighbours, std::vector<int> *keys = NULL)
+    {
+        pad_to(v);
+        std::vector<int> zeros;
+        if (keyed && keys == NULL)
+        {
+            zeros.assign(neighbours.size(), 0);
+            keys = &zeros;
+        }
+        if (keyed)
+        {
+            std::vector<std::pair<int, int>> pairs(neighbours.size());
+            for (size_t i = 0; i < neighbours.size(); i++)
+                pairs[i] = {neighbours[i], (*keys)[i]};
+            std::sort(pairs.begin(), pairs.end());
+            pairs.erase(std::unique(pairs.begin(), pairs.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b)
+                                    { return a.first == b.first; }),
+                        pairs.end());
+            neighbours.resize(pairs.size());
+            keys->resize(pairs.size());
+            for (size_t i = 0; i < pairs.size(); i++)
+            {
+                neighbours[i] = pairs[i].first;
+                (*keys)[i] = pairs[i].second;
+            }
+        }
+        else
+        {
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        }
+
+        varint_put(bytes, (uint32_t)neighbours.size() << 1 | (keyed ? 1 : 0));
+        uint32_t prev = 0;
+        for (size_t i = 0; i < neighbours.size(); i++)
+        {
+            varint_put(bytes, i == 0 ? (uint32_t)neighbours[i] : (uint32_t)neighbours[i] - prev);
+            prev = (uint32_t)neighbours[i];
+        }
+        if (keyed)
+            for (int key : *keys)
+                varint_put(bytes, (uint32_t)key);
+        offsets.push_back(bytes.size());
+    }
+
+    /**
+     * Add empty rows until the adjacency holds n vertices
+     */
+    void pad_to(int n)
+    {
+        while (vertices() < n)
+        {
+            varint_put(bytes, keyed ? 1 : 0);
+            offsets.push_back(bytes.size());
+        }
+    }
+
+    int vertices() const { return (int)offsets.size() - 1; }
+    size_t memory_bytes() const { return bytes.size() + offsets.size() * sizeof(uint64_t); }
+    AdjacencyView view() const { return AdjacencyView{vertices(), offsets.data(), bytes.data()}; }
+
+    large_vector<uint64_t> offsets;
+    large_vector<uint8_t> bytes;
+    bool keyed; // rows carry ordering keys, set before the first row is added
+};
+
+/**
+ * Append rows for edges held in memory, in any order
+ *
+ * @param adjacency The adjacency that rows are appended to, holds no rows yet
+ * @param edges Source, destination and key of every edge, sorted by source here (stable, a duplicate edge keeps its lowest key)
+ */
+inline void add_edge_rows(CompressedAdjacency &adjacency, std::vector<std::array<int, 3>> &edges)
+{
+    std::stable_sort(edges.begin(), edges.end(), [](const std::array<int, 3> &a, const std::array<int, 3> &b)
+                     { return a[0] < b[0]; });
+    std::vector<int> row, keys;
+    for (size_t i = 0; i < edges.size();)
+    {
+        int source = edges[i][0];
+        row.clear();
+        keys.clear();
+        for (; i < edges.size() && edges[i][0] == source; i++)
+        {
+            row.push_back(edges[i][1]);
+            keys.push_back(edges[i][2]);
+        }
+        adjacency.add_row(source, row, &keys);
+    }
+}
+
+/**
+ * Read an edge list ("source dest" per line) into a compressed adjacency
+ * Edges sorted by source are gap-coded while reading. Once a source is smaller than one before it, the rows coded so far and
+ * the rest of the edges are collected and sorted by source first, so the input may come in any order at the cost of an edge array.
+ * An optional third column is the ordering key of the edge ("source dest key", see NeighbourTable): the first edge line
+ * decides whether the adjacency is keyed, later lines without a key get key 0 (as do negative keys) and keys of an unkeyed list are ignored.
+ * Lines that do not hold two non-negative integers are skipped
+ *
+ * @param in The stream to read from
+ * @param adjacency The adjacency that rows are appended to, holds no rows yet
+ * @param n The minimum amount of vertices, the adjacency is padded with empty rows up to n
+ */
+inline void read_edge_list(std::istream &in, CompressedAdjacency &adjacency, int n = 0)
+{
+    std::vector<int> row, keys;
+    std::vector<std::array<int, 3>> unsorted; // every edge, once the source went backwards
+    std::string line;
+    int source, dest, key;
+    int current = -1;
+
+    while (getline(in, line))
+    {
+        int fields = sscanf(line.c_str(), "%i %i %i", &source, &dest, &key);
+        if (fields < 2 || source < 0 || dest < 0)
+            continue;
+        key = fields == 3 && key > 0 ? key : 0;
+        if (current == -1 && adjacency.vertices() == 0 && unsorted.empty())
+            adjacency.keyed = fields == 3;
+        if (!unsorted.empty())
+        {
+            unsorted.push_back({source, dest, key});
+            continue;
+        }
+        if (source != current)
+        {
+            if (current != -1)
+                adjacency.add_row(current, row, &keys);
+            row.clear();
+            keys.clear();
+            current = source;
+            if (source < adjacency.vertices()) // out of order: decode what was coded and collect everything from here on
+            {
+                AdjacencyView view = adjacency.view();
+                for (int v = 0; v < view.n; v++)
+                {
+                    NeighbourRange range = view.neighbours(v);
+                    const uint8_t *key_pos = range.keyed() ? range.keys() : NULL;
+                    for (int u : range)
+                    {
+                        uint32_t k = 0;
+                        if (key_pos != NULL)
+                            key_pos = varint_get(key_pos, &k);
+                        unsorted.push_back({v, u, (int)k});
+                    }
+                }
+                unsorted.push_back({source, dest, key});
+                adjacency.offsets.assign(1, 0);
+                adjacency.bytes.clear();
+                current = -1;
+                continue;
+            }
+        }
+        row.push_back(dest);
+        keys.push_back(key);
+    }
+    if (current != -1)
+        adjacency.add_row(current, row, &keys);
+    if (!unsorted.empty())
+        add_edge_rows(adjacency, unsorted);
+    adjacency.pad_to(n);
+}
+
+#endif
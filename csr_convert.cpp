@@ -0,0 +1,30 @@
+/**
+* Convert an edge list into a mapped CSR file for the PDDFS algorithm
+* The program reads the same input as the algorithm on STDIN (edges in any order)
+* The first argument is the output file
+* The optional second argument is the number of vertices, vertices without edges are padded up to it
+*/
+
+#include <iostream>
+#include <string>
+#include "mapped_csr.h"
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "usage: " << argv[0] << " <output file> [vertices] < edges" << endl;
+        return 1;
+    }
+    CompressedAdjacency adjacency;
+    read_edge_list(cin, adjacency, argc > 2 ? stoi(argv[2]) : 0);
+    if (!write_mapped_csr(argv[1], adjacency))
+    {
+        cerr << "could not write " << argv[1] << endl;
+        return 1;
+    }
+    cout << adjacency.vertices() << " vertices, " << adjacency.bytes.size() << " row bytes" << endl;
+    return 0;
+}
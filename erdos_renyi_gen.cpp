@@ -4,6 +4,7 @@
 * The program takes two command line arguments
 * The first argument is the number of nodes
 * The second argument is the chance that two nodes are connected (between 0 and 1)
+* An optional third argument seeds the generator, so benchmark graphs can be reproduced
 */
 
 #include <iostream>
@@ -14,7 +15,7 @@ using namespace std;
 
 int main(int argc, char *argv[])
 {
-    srand(time(NULL));
+    srand(argc > 3 ? stoul(argv[3]) : time(NULL));
     int n = stoi(argv[1]);
     float frac = stof(argv[2]);
     vector<pair<int, int>> edges;
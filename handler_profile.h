@@ -0,0 +1,241 @@
+/**
+ * Per-handler cost accounting for the protocol loop of the PDDFS algorithm
+ * With --profile-handlers every section of the loop (waiting in MPI_Probe, the three message handlers, and the path
+ * comparisons and child set updates inside them) is timed with the time stamp counter. With --perf-counters the
+ * hardware counters for instructions, cache misses and branch misses are also read around every section.
+ * Sections nest: the path comparison and child set costs are included in the handler that performs them.
+ * Totals are per process and end up in the metrics report, which reduces them over all processes.
+ *
+ * Counters are opened with perf_event_open for the calling thread, user space only. When the kernel does not allow it
+ * (perf_event_paranoid, containers) the run continues with cycle accounting only, perf_counters_available is 0 and the
+ * counter metrics of the process are 0.
+ */
+
+#ifndef HANDLER_PROFILE_H
+#define HANDLER_PROFILE_H
+
+#include <mpi.h>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#include "metrics.h"
+#include "protocol_core.h"
+
+#define PERF_COUNTERS 3 // instructions, cache misses, branch misses
+
+/**
+ * @return The time stamp counter, or nanoseconds of the monotonic clock on machines without one
+ */
+inline uint64_t read_cycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+#endif
+}
+
+/**
+ * One group of hardware counters for the calling thread, read with a single system call
+ */
+class PerfCounters
+{
+public:
+    PerfCounters() : leader(-1) {}
+    ~PerfCounters() { close(); }
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    /**
+     * Open and start the counters
+     *
+     * @return false if the kernel refused any of them, nothing is left open then
+     */
+    bool open()
+    {
+        const uint64_t configs[PERF_COUNTERS] = {PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int i = 0; i < PERF_COUNTERS; i++)
+        {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = i == 0; // the group starts when the leader is enabled
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fds[i] < 0)
+            {
+                for (int j = 0; j < i; j++)
+                    ::close(fds[j]);
+                leader = -1;
+                return false;
+            }
+            if (i == 0)
+                leader = fds[0];
+        }
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+    }
+
+    void close()
+    {
+        if (leader < 0)
+            return;
+        for (int i = 0; i < PERF_COUNTERS; i++)
+            ::close(fds[i]);
+        leader = -1;
+    }
+
+    bool is_open() const { return leader >= 0; }
+
+    /**
+     * Read the current counter values
+     *
+     * @param values Written with PERF_COUNTERS values, unchanged if the read fails
+     */
+    void read(uint64_t values[]) const
+    {
+        uint64_t buffer[1 + PERF_COUNTERS]; // PERF_FORMAT_GROUP: the count of events, then their values
+        if (::read(leader, buffer, sizeof(buffer)) == (ssize_t)sizeof(buffer))
+            memcpy(values, buffer + 1, sizeof(uint64_t) * PERF_COUNTERS);
+    }
+
+private:
+    int leader;
+    int fds[PERF_COUNTERS];
+};
+
+/**
+ * Accumulated cost of every profile section on the current process
+ */
+class HandlerProfile
+{
+public:
+    HandlerProfile() : enabled(false), start_cycles(0), start_time(0)
+    {
+        memset(calls, 0, sizeof(calls));
+        memset(cycles, 0, sizeof(cycles));
+        memset(events, 0, sizeof(events));
+    }
+
+    /**
+     * Start accounting
+     *
+     * @param hardware Also read the hardware counters around every section
+     */
+    void enable(bool hardware)
+    {
+        enabled = true;
+        if (hardware)
+            counters.open();
+        start_cycles = read_cycles();
+        start_time = MPI_Wtime();
+    }
+
+    bool enabled;
+    PerfCounters counters;
+    uint64_t calls[PROFILE_SECTIONS];
+    uint64_t cycles[PROFILE_SECTIONS];
+    uint64_t events[PROFILE_SECTIONS][PERF_COUNTERS];
+
+    /**
+     * Add the totals of every section to a metrics report as handler_<section>_<quantity>
+     * Cycles are also converted to seconds with the counter rate measured over the profiled run.
+     */
+    void add_to(MetricsReport &report) const
+    {
+        static const char *sections[PROFILE_SECTIONS] = {"probe", "discover", "reject", "terminate", "path_order", "child_set"};
+        static const char *event_names[PERF_COUNTERS] = {"instructions", "cache_misses", "branch_misses"};
+        double elapsed = MPI_Wtime() - start_time;
+        double cycles_per_second = elapsed > 0 ? (read_cycles() - start_cycles) / elapsed : 0;
+        report.add("perf_counters_available", counters.is_open());
+        for (int s = 0; s < PROFILE_SECTIONS; s++)
+        {
+            std::string prefix = std::string("handler_") + sections[s];
+            report.add(prefix + "_calls", calls[s]);
+            report.add(prefix + "_cycles", cycles[s]);
+            report.add(prefix + "_s", cycles_per_second > 0 ? cycles[s] / cycles_per_second : 0);
+            for (int e = 0; e < PERF_COUNTERS; e++) // 0 without counters: every process adds the same metrics for the reduction
+                report.add(prefix + "_" + event_names[e], events[s][e]);
+        }
+    }
+
+private:
+    uint64_t start_cycles;
+    double start_time;
+};
+
+inline HandlerProfile &handler_profile()
+{
+    static HandlerProfile profile;
+    return profile;
+}
+
+/**
+ * Charges the lifetime of the scope to a section, does nothing when profiling is off
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(ProfileSection section) : section(section), profile(handler_profile())
+    {
+        if (!profile.enabled)
+            return;
+        if (profile.counters.is_open())
+            profile.counters.read(start_events);
+        start_cycles = read_cycles();
+    }
+
+    ~ProfileScope()
+    {
+        if (!profile.enabled)
+            return;
+        profile.cycles[section] += read_cycles() - start_cycles;
+        profile.calls[section]++;
+        if (profile.counters.is_open())
+        {
+            uint64_t end_events[PERF_COUNTERS];
+            memcpy(end_events, start_events, sizeof(end_events));
+            profile.counters.read(end_events);
+            for (int e = 0; e < PERF_COUNTERS; e++)
+                profile.events[section][e] += end_events[e] - start_events[e];
+        }
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    ProfileSection section;
+    HandlerProfile &profile;
+    uint64_t start_cycles = 0;
+    uint64_t start_events[PERF_COUNTERS] = {};
+};
+
+/**
+ * Call f() charged to a section
+ *
+ * @return What f returns
+ */
+template <typename F>
+inline auto profiled(ProfileSection section, F f) -> decltype(f())
+{
+    ProfileScope scope(section);
+    return f();
+}
+
+#endif
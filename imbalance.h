@@ -0,0 +1,74 @@
+/**
+ * Load imbalance report of a PDDFS run
+ * Every process measures how long it was busy handling messages and how long it was idle waiting for one,
+ * from the start of the protocol loop until its vertex terminated. The root gathers the loads of all processes and prints
+ * the max/mean ratio of every quantity (1 is perfectly balanced) and the busiest processes with the vertex they host:
+ *   IMBALANCE busy_s <max/mean> idle_s <max/mean> messages <max/mean> degree <max/mean>
+ *   BUSIEST <place> rank <r> vertex <v> busy_s <s> idle_s <s> messages <n> degree <d>
+ * The degree is included since high degree vertices (hubs) are the candidates for a different partitioning.
+ */
+
+#ifndef IMBALANCE_H
+#define IMBALANCE_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+enum LoadValue
+{
+    LOAD_BUSY,
+    LOAD_IDLE,
+    LOAD_MESSAGES,
+    LOAD_DEGREE,
+    LOAD_VERTEX,
+    LOAD_VALUES
+};
+
+/**
+ * Gather the loads of all processes and print the imbalance summary on the root, collective
+ *
+ * @param load The LOAD_VALUES values of the current process
+ * @param top The amount of busiest processes to list
+ */
+inline void print_imbalance(MPI_Comm comm, int root, const double load[LOAD_VALUES], int top, FILE *out)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    std::vector<double> loads(rank == root ? (size_t)size * LOAD_VALUES : 0);
+    MPI_Gather(load, LOAD_VALUES, MPI_DOUBLE, loads.data(), LOAD_VALUES, MPI_DOUBLE, root, comm);
+    if (rank != root)
+        return;
+
+    static const char *names[LOAD_VERTEX] = {"busy_s", "idle_s", "messages", "degree"};
+    fprintf(out, "IMBALANCE");
+    for (int v = 0; v < LOAD_VERTEX; v++)
+    {
+        double max = 0, sum = 0;
+        for (int r = 0; r < size; r++)
+        {
+            max = std::max(max, loads[r * LOAD_VALUES + v]);
+            sum += loads[r * LOAD_VALUES + v];
+        }
+        fprintf(out, " %s %.3f", names[v], sum > 0 ? max / (sum / size) : 1.0);
+    }
+    fprintf(out, " (max/mean over %d processes)\n", size);
+
+    std::vector<int> ranks(size);
+    for (int r = 0; r < size; r++)
+        ranks[r] = r;
+    top = std::min(top, size);
+    std::partial_sort(ranks.begin(), ranks.begin() + top, ranks.end(), [&](int a, int b)
+                      { return loads[a * LOAD_VALUES + LOAD_BUSY] > loads[b * LOAD_VALUES + LOAD_BUSY]; });
+    for (int i = 0; i < top; i++)
+    {
+        const double *l = &loads[ranks[i] * LOAD_VALUES];
+        fprintf(out, "BUSIEST %d rank %d vertex %d busy_s %.6f idle_s %.6f messages %.0f degree %.0f\n", i + 1, ranks[i],
+                (int)l[LOAD_VERTEX], l[LOAD_BUSY], l[LOAD_IDLE], l[LOAD_MESSAGES], l[LOAD_DEGREE]);
+    }
+    fflush(out);
+}
+
+#endif
@@ -0,0 +1,131 @@
+/**
+ * Huge-page backing for the large arrays of the PDDFS algorithm
+ * With --hugepages transparent large allocations are 2 MB aligned and marked with madvise(MADV_HUGEPAGE),
+ * with --hugepages explicit they are taken from the hugetlbfs pool (MAP_HUGETLB) first and fall back to transparent huge pages
+ * when the pool is empty. Allocations below 2 MB are served by malloc, a huge page would mostly be wasted on them.
+ * The mode is set once at startup, before anything is allocated through LargePageAllocator.
+ */
+
+#ifndef LARGE_PAGES_H
+#define LARGE_PAGES_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+#define LARGE_PAGE_SIZE ((size_t)2 << 20)
+
+enum LargePageMode
+{
+    PAGES_DEFAULT,
+    PAGES_TRANSPARENT,
+    PAGES_EXPLICIT
+};
+
+/**
+ * Process-wide huge page settings and counters
+ */
+struct LargePageState
+{
+    LargePageMode mode = PAGES_DEFAULT;
+    long explicit_allocations = 0;
+    long transparent_allocations = 0;
+    long fallbacks = 0; // explicit allocations that had to use transparent huge pages
+};
+
+inline LargePageState &large_pages()
+{
+    static LargePageState state;
+    return state;
+}
+
+inline size_t round_to_large_page(size_t bytes)
+{
+    return (bytes + LARGE_PAGE_SIZE - 1) & ~(LARGE_PAGE_SIZE - 1);
+}
+
+/**
+ * Allocate memory according to the huge page mode
+ *
+ * @param bytes The size of the allocation
+ * @return The allocated memory, release with free_large()
+ */
+inline void *alloc_large(size_t bytes)
+{
+    LargePageState &state = large_pages();
+    if (state.mode == PAGES_DEFAULT || bytes < LARGE_PAGE_SIZE)
+    {
+        void *p = malloc(bytes);
+        if (p == NULL)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    size_t length = round_to_large_page(bytes);
+    if (state.mode == PAGES_EXPLICIT)
+    {
+        void *p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED)
+        {
+            state.explicit_allocations++;
+            return p;
+        }
+        state.fallbacks++;
+    }
+
+    // over-allocate so the region can be trimmed to a 2 MB boundary, a transparent huge page needs an aligned range
+    uint8_t *raw = (uint8_t *)mmap(NULL, length + LARGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        throw std::bad_alloc();
+    uint8_t *aligned = (uint8_t *)(((uintptr_t)raw + LARGE_PAGE_SIZE - 1) & ~(uintptr_t)(LARGE_PAGE_SIZE - 1));
+    if (aligned != raw)
+        munmap(raw, aligned - raw);
+    munmap(aligned + length, raw + LARGE_PAGE_SIZE - aligned);
+    madvise(aligned, length, MADV_HUGEPAGE);
+    state.transparent_allocations++;
+    return aligned;
+}
+
+/**
+ * Release memory from alloc_large()
+ *
+ * @param p The allocation
+ * @param bytes The size that was passed to alloc_large()
+ */
+inline void free_large(void *p, size_t bytes)
+{
+    if (p == NULL)
+        return;
+    if (large_pages().mode == PAGES_DEFAULT || bytes < LARGE_PAGE_SIZE)
+        free(p);
+    else
+        munmap(p, round_to_large_page(bytes));
+}
+
+/**
+ * Standard allocator on top of alloc_large(), for containers that can grow large
+ */
+template <typename T>
+struct LargePageAllocator
+{
+    typedef T value_type;
+
+    LargePageAllocator() {}
+    template <typename U>
+    LargePageAllocator(const LargePageAllocator<U> &) {}
+
+    T *allocate(size_t n) { return (T *)alloc_large(n * sizeof(T)); }
+    void deallocate(T *p, size_t n) { free_large(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const LargePageAllocator<U> &) const { return true; }
+    template <typename U>
+    bool operator!=(const LargePageAllocator<U> &) const { return false; }
+};
+
+template <typename T>
+using large_vector = std::vector<T, LargePageAllocator<T>>;
+
+#endif
@@ -0,0 +1,213 @@
+/**
+ * Message delivery latency of the PDDFS protocol
+ * With --latency every message carries a send time stamp of MESSAGE_STAMP_INTS ints after its payload (after the path of a
+ * DISCOVER, as the only content of a REJECT or TERMINATE). The receiving handler records the time from send to handling,
+ * which includes the time in flight and the time spent in the unexpected message queue before MPI_Probe picked it up.
+ * Latencies are kept per message type in log-linear (HDR style) histograms with 2^(LATENCY_SUB_BITS - 1) linear
+ * sub-buckets per power of two, so every recorded value is known within about 6%. At the end the histograms of all
+ * processes are summed and the root prints percentiles per type.
+ *
+ * Time stamps are CLOCK_REALTIME nanoseconds: MPI_Wtime may count from a per-process origin, the real time clock is
+ * shared by all processes of a machine. Across machines it is only as close as their clock synchronisation,
+ * negative latencies caused by clock skew are recorded as 0.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <mpi.h>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <vector>
+
+#define MESSAGE_STAMP_INTS 2 // one uint64_t
+#define LATENCY_SUB_BITS 5
+#define LATENCY_BUCKETS ((64 - LATENCY_SUB_BITS + 2) << (LATENCY_SUB_BITS - 1))
+#define LATENCY_TYPES 3 // DISCOVER, REJECT, TERMINATE, indexed by message type - 1
+
+/**
+ * Histogram of latencies in nanoseconds
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram() : max(0) { memset(counts, 0, sizeof(counts)); }
+
+    /**
+     * @return The bucket of value, values below 2^LATENCY_SUB_BITS have a bucket of their own
+     */
+    static int bucket_of(uint64_t value)
+    {
+        const int half = 1 << (LATENCY_SUB_BITS - 1);
+        int magnitude = value == 0 ? 0 : 63 - __builtin_clzll(value);
+        int shift = magnitude < LATENCY_SUB_BITS ? 0 : magnitude - (LATENCY_SUB_BITS - 1);
+        return shift * half + (int)(value >> shift);
+    }
+
+    /**
+     * @return The highest value that falls into bucket
+     */
+    static uint64_t bucket_value(int bucket)
+    {
+        const int half = 1 << (LATENCY_SUB_BITS - 1);
+        int shift = bucket < 2 * half ? 0 : bucket / half - 1;
+        uint64_t sub = bucket - shift * half;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void record(uint64_t value)
+    {
+        counts[bucket_of(value)]++;
+        if (value > max)
+            max = value;
+    }
+
+    uint64_t count() const
+    {
+        uint64_t total = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+            total += counts[i];
+        return total;
+    }
+
+    /**
+     * @param fraction The fraction of values that is at most the result, between 0 and 1
+     * @return The upper edge of the bucket holding that value, capped at the largest recorded value
+     */
+    uint64_t percentile(double fraction) const
+    {
+        uint64_t total = count(), seen = 0;
+        uint64_t wanted = (uint64_t)(fraction * total + 0.5);
+        if (wanted == 0)
+            wanted = 1;
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+        {
+            seen += counts[i];
+            if (seen >= wanted)
+                return bucket_value(i) < max ? bucket_value(i) : max;
+        }
+        return max;
+    }
+
+    uint64_t counts[LATENCY_BUCKETS];
+    uint64_t max;
+};
+
+/**
+ * Process-wide latency settings and histograms
+ */
+struct MessageLatency
+{
+    bool enabled = false;
+    LatencyHistogram histograms[LATENCY_TYPES];
+    std::deque<std::array<int, MESSAGE_STAMP_INTS>> control_stamps; // send buffers of REJECT and TERMINATE stamps, stable addresses
+    std::vector<int *> free_stamps;                                 // buffers of completed sends, reused before the deque grows
+};
+
+inline MessageLatency &message_latency()
+{
+    static MessageLatency latency;
+    return latency;
+}
+
+/**
+ * @return The amount of ints every message carries for its stamp, 0 when latency is not measured
+ */
+inline int stamp_ints()
+{
+    return message_latency().enabled ? MESSAGE_STAMP_INTS : 0;
+}
+
+/**
+ * @return The current time in nanoseconds
+ */
+inline uint64_t stamp_now()
+{
+    timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return (uint64_t)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/**
+ * Write the current time to a stamp
+ */
+inline void write_stamp(int *stamp)
+{
+    uint64_t now = stamp_now();
+    memcpy(stamp, &now, sizeof(now));
+}
+
+/**
+ * @return A stamp of the current time for a message without payload, valid until it is passed to release_stamp()
+ */
+inline int *control_stamp()
+{
+    MessageLatency &latency = message_latency();
+    int *stamp;
+    if (!latency.free_stamps.empty())
+    {
+        stamp = latency.free_stamps.back();
+        latency.free_stamps.pop_back();
+    }
+    else
+    {
+        latency.control_stamps.emplace_back();
+        stamp = latency.control_stamps.back().data();
+    }
+    write_stamp(stamp);
+    return stamp;
+}
+
+/**
+ * Return the stamp of a completed send for reuse
+ */
+inline void release_stamp(int *stamp)
+{
+    message_latency().free_stamps.push_back(stamp);
+}
+
+/**
+ * Record the latency of a received message, does nothing when latency is not measured
+ *
+ * @param type The message type
+ * @param stamp The stamp the message carried
+ */
+inline void record_latency(int type, const int *stamp)
+{
+    MessageLatency &latency = message_latency();
+    if (!latency.enabled)
+        return;
+    uint64_t sent, now = stamp_now();
+    memcpy(&sent, stamp, sizeof(sent));
+    latency.histograms[type - 1].record(now > sent ? now - sent : 0);
+}
+
+/**
+ * Sum the histograms of all processes and print percentiles per message type on the root, collective
+ * Format: LATENCY <type> count <n> p50 <us> p90 <us> p99 <us> max <us>
+ */
+inline void print_latency(MPI_Comm comm, int root, FILE *out)
+{
+    static const char *types[LATENCY_TYPES] = {"discover", "reject", "terminate"};
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    for (int t = 0; t < LATENCY_TYPES; t++)
+    {
+        const LatencyHistogram &local = message_latency().histograms[t];
+        LatencyHistogram merged;
+        MPI_Reduce(local.counts, merged.counts, LATENCY_BUCKETS, MPI_UINT64_T, MPI_SUM, root, comm);
+        MPI_Reduce(&local.max, &merged.max, 1, MPI_UINT64_T, MPI_MAX, root, comm);
+        if (rank != root)
+            continue;
+        fprintf(out, "LATENCY %s count %llu p50 %.3f p90 %.3f p99 %.3f max %.3f (us)\n", types[t], (unsigned long long)merged.count(),
+                merged.percentile(0.5) / 1e3, merged.percentile(0.9) / 1e3, merged.percentile(0.99) / 1e3, merged.max / 1e3);
+    }
+    if (rank == root)
+        fflush(out);
+}
+
+#endif
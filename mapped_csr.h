@@ -0,0 +1,164 @@
+/**
+ * On-disk compressed CSR that is memory-mapped instead of read into memory
+ * File layout (native endianness):
+ *   8 bytes   magic "PDDFSCS2"
+ *   uint64    n, the amount of vertices
+ *   uint64    size of the row bytes
+ *   uint64    offsets[n + 1]
+ *   uint8     row bytes, gap-coded as described in compressed_adjacency.h, with ordering keys if the edge list had them
+ * Rows are stored in vertex order, so the processes of one machine (which get consecutive ranks) read neighbouring
+ * pages of the file and share them through the page cache. Pages of rows that are never read are never loaded.
+ *
+ * Files are produced from an edge list with csr_convert. A file is not trusted: open() checks the header and the offsets,
+ * a row is checked with valid_row() before it is decoded.
+ */
+
+#ifndef MAPPED_CSR_H
+#define MAPPED_CSR_H
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "compressed_adjacency.h"
+#include "large_pages.h"
+
+#define MAPPED_CSR_MAGIC "PDDFSCS2" // rows with the keyed flag, older files are rejected
+
+/**
+ * Write a compressed adjacency to a file in the mapped CSR layout
+ *
+ * @param path The file to write
+ * @param adjacency The adjacency to store
+ * @return true on success
+ */
+inline bool write_mapped_csr(const char *path, const CompressedAdjacency &adjacency)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+    uint64_t header[2] = {(uint64_t)adjacency.vertices(), (uint64_t)adjacency.bytes.size()};
+    bool ok = fwrite(MAPPED_CSR_MAGIC, 1, 8, file) == 8 &&
+              fwrite(header, sizeof(uint64_t), 2, file) == 2 &&
+              fwrite(adjacency.offsets.data(), sizeof(uint64_t), adjacency.offsets.size(), file) == adjacency.offsets.size() &&
+              fwrite(adjacency.bytes.data(), 1, adjacency.bytes.size(), file) == adjacency.bytes.size();
+    return fclose(file) == 0 && ok;
+}
+
+/**
+ * Read-only memory mapping of a mapped CSR file
+ */
+class MappedCsr
+{
+public:
+    MappedCsr() : base(NULL), length(0) {}
+    ~MappedCsr() { close(); }
+    MappedCsr(const MappedCsr &) = delete;
+    MappedCsr &operator=(const MappedCsr &) = delete;
+
+    /**
+     * Map a file, access is declared random since every process only reads its own rows
+     *
+     * @param path The file to map
+     * @return true if the file was mapped and has a valid header
+     */
+    bool open(const char *path)
+    {
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < 24)
+        {
+            ::close(fd);
+            return false;
+        }
+        void *mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        base = (const uint8_t *)mapped;
+        length = st.st_size;
+        madvise(mapped, length, MADV_RANDOM);
+        if (large_pages().mode != PAGES_DEFAULT)
+            madvise(mapped, length, MADV_HUGEPAGE); // only honoured for file mappings on filesystems with huge page support
+
+        uint64_t header[2];
+        memcpy(header, base + 8, sizeof(header));
+        if (memcmp(base, MAPPED_CSR_MAGIC, 8) != 0 || !valid_layout(header[0], header[1]))
+        {
+            close();
+            return false;
+        }
+        adjacency.n = (int)header[0];
+        adjacency.offsets = (const uint64_t *)(base + 24);
+        adjacency.bytes = base + 24 + (header[0] + 1) * sizeof(uint64_t);
+        return true;
+    }
+
+    void close()
+    {
+        if (base != NULL)
+            munmap((void *)base, length);
+        base = NULL;
+        length = 0;
+    }
+
+    const AdjacencyView &view() const { return adjacency; }
+
+    /**
+     * Check one row before it is decoded, see valid_row(). The offsets are checked on open, the rows are not, so a
+     * process that only reads its own row only touches its own pages.
+     */
+    bool valid_row(int v) const { return ::valid_row(adjacency.bytes + adjacency.offsets[v], adjacency.row_size(v), adjacency.n); }
+
+    /**
+     * Check every row, for a reader that decodes the whole graph
+     */
+    bool valid_rows() const
+    {
+        for (int v = 0; v < adjacency.n; v++)
+            if (!valid_row(v))
+                return false;
+        return true;
+    }
+
+private:
+    /**
+     * Check the sizes of the header against the file and the offsets against the row bytes, so a corrupt file cannot
+     * make a row read outside the mapping. Reads the offset table once, not the rows.
+     *
+     * @param n The amount of vertices from the header
+     * @param size The size of the row bytes from the header
+     */
+    bool valid_layout(uint64_t n, uint64_t size) const
+    {
+        uint64_t available = length - 24;
+        if (n > INT_MAX || n + 1 > available / sizeof(uint64_t)) // also keeps (n + 1) * 8 from overflowing
+            return false;
+        available -= (n + 1) * sizeof(uint64_t);
+        if (size > available)
+            return false;
+        const uint8_t *offsets = base + 24;
+        uint64_t previous = 0;
+        for (uint64_t v = 0; v <= n; v++)
+        {
+            uint64_t offset;
+            memcpy(&offset, offsets + v * sizeof(uint64_t), sizeof(offset));
+            if ((v == 0 && offset != 0) || (v > 0 && offset <= previous) || offset > size) // every row holds at least its degree
+                return false;
+            previous = offset;
+        }
+        return true;
+    }
+
+    const uint8_t *base;
+    size_t length;
+    AdjacencyView adjacency;
+};
+
+#endif
@@ -0,0 +1,161 @@
+/**
+ * Record and replay of the order in which a process handles messages
+ * The outcome of the PDDFS algorithm depends on the order in which messages arrive, so two runs on the same graph can
+ * differ in their message counts and tree. With --record <prefix> every process logs the (source rank, tag) of every
+ * message it handles to <prefix>.<rank>. With --replay <prefix> every process probes for exactly the logged source and tag
+ * in turn instead of taking whatever message arrives first. MPI keeps messages between one pair of processes with one tag in
+ * order, so this handles the same messages in the same order, and since the handlers are deterministic the replayed run
+ * sends the same messages and produces the same tree as the recorded one.
+ *
+ * File layout: 8 bytes magic "PDDFSLOG", then one LEB128 value (source << 2 | tag) per handled message.
+ * Recording buffers the events in memory and writes them when the buffer is full, when the log is closed and when the state
+ * of the process is dumped (SIGUSR1), so the protocol loop makes no system call per message. To keep the complete log of a
+ * run that hangs, request a dump before killing it: the log then replays up to the hang. A truncated final event (a process
+ * killed during a write) ends the replay.
+ */
+
+#ifndef MESSAGE_LOG_H
+#define MESSAGE_LOG_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "compressed_adjacency.h"
+
+#define MESSAGE_LOG_MAGIC "PDDFSLOG"
+#define MESSAGE_LOG_TAG_BITS 2
+#define MESSAGE_LOG_BUFFER 65536 // bytes of events kept in memory before they are written
+
+class MessageLog
+{
+public:
+    MessageLog() : file(NULL), position(0), replaying_(false), exhausted(false) {}
+    ~MessageLog() { close(); }
+    MessageLog(const MessageLog &) = delete;
+    MessageLog &operator=(const MessageLog &) = delete;
+
+    /**
+     * @return The log file of a process
+     */
+    static std::string path(const std::string &prefix, int rank) { return prefix + "." + std::to_string(rank); }
+
+    /**
+     * Start recording to a file
+     *
+     * @return false if the file cannot be created
+     */
+    bool record(const std::string &path)
+    {
+        file = fopen(path.c_str(), "wb");
+        return file != NULL && fwrite(MESSAGE_LOG_MAGIC, 1, 8, file) == 8;
+    }
+
+    /**
+     * Load a recorded log for replay
+     *
+     * @return false if the file cannot be read or is not a message log
+     */
+    bool replay(const std::string &path)
+    {
+        FILE *in = fopen(path.c_str(), "rb");
+        if (in == NULL)
+            return false;
+        char magic[8];
+        bool ok = fread(magic, 1, 8, in) == 8 && memcmp(magic, MESSAGE_LOG_MAGIC, 8) == 0;
+        uint8_t buffer[4096];
+        size_t n;
+        while (ok && (n = fread(buffer, 1, sizeof(buffer), in)) > 0)
+            events.insert(events.end(), buffer, buffer + n);
+        fclose(in);
+        replaying_ = ok;
+        return ok;
+    }
+
+    bool recording() const { return file != NULL; }
+    bool replaying() const { return replaying_; }
+
+    /**
+     * Log a handled message
+     */
+    void append(int source, int tag)
+    {
+        varint_put(pending, ((uint32_t)source << MESSAGE_LOG_TAG_BITS) | (uint32_t)tag);
+        if (pending.size() >= MESSAGE_LOG_BUFFER)
+            write_pending();
+    }
+
+    /**
+     * Write the buffered events to the file and flush it
+     */
+    void flush()
+    {
+        if (file == NULL)
+            return;
+        write_pending();
+        fflush(file);
+    }
+
+    /**
+     * Take the next message to handle from the replayed log
+     *
+     * @return false when the log is exhausted
+     */
+    bool next(int *source, int *tag)
+    {
+        if (position >= events.size())
+        {
+            exhausted = true;
+            return false;
+        }
+        uint32_t value = 0;
+        int shift = 0;
+        uint8_t byte;
+        do
+        {
+            if (position >= events.size() || shift > 28) // a truncated or malformed final event
+            {
+                position = events.size();
+                exhausted = true;
+                return false;
+            }
+            byte = events[position++];
+            value |= (uint32_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        *source = (int)(value >> MESSAGE_LOG_TAG_BITS);
+        *tag = (int)(value & ((1 << MESSAGE_LOG_TAG_BITS) - 1));
+        return true;
+    }
+
+    /**
+     * @return true if the replayed run handled exactly the logged messages
+     */
+    bool matched() const { return !exhausted && position == events.size(); }
+
+    void close()
+    {
+        if (file == NULL)
+            return;
+        write_pending();
+        fclose(file);
+        file = NULL;
+    }
+
+private:
+    void write_pending()
+    {
+        fwrite(pending.data(), 1, pending.size(), file);
+        pending.clear();
+    }
+
+    FILE *file;
+    std::vector<uint8_t> pending; // recorded events not written yet
+    std::vector<uint8_t> events;
+    size_t position;
+    bool replaying_;
+    bool exhausted; // more messages were handled than logged
+};
+
+#endif
@@ -0,0 +1,178 @@
+/**
+ * Metrics report of a PDDFS run
+ * Every process adds the same named values in the same order, print() reduces them over all processes
+ * and the root prints one line per metric:
+ *   METRIC <name> <min> <max> <mean> <sum>
+ * The lines are meant to be read by scripts (bench/run_benchmarks.sh), a single header line starting with '#' precedes them.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <mpi.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include "large_pages.h"
+
+class MetricsReport
+{
+public:
+    /**
+     * Add a metric of the current process
+     *
+     * @param name The name of the metric, without spaces
+     * @param value The value on the current process
+     */
+    void add(const std::string &name, double value)
+    {
+        names.push_back(name);
+        values.push_back(value);
+    }
+
+    /**
+     * Reduce all metrics over the communicator and print them on the root, collective
+     *
+     * @param comm The communicator of all processes that added the metrics
+     * @param root The process that prints the report
+     * @param out The stream the report is written to
+     */
+    void print(MPI_Comm comm, int root, FILE *out) const
+    {
+        int rank, size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        int n = (int)values.size();
+        std::vector<double> min(n), max(n), sum(n);
+        MPI_Reduce(values.data(), min.data(), n, MPI_DOUBLE, MPI_MIN, root, comm);
+        MPI_Reduce(values.data(), max.data(), n, MPI_DOUBLE, MPI_MAX, root, comm);
+        MPI_Reduce(values.data(), sum.data(), n, MPI_DOUBLE, MPI_SUM, root, comm);
+        if (rank != root)
+            return;
+        fprintf(out, "# metric min max mean sum (over %d processes)\n", size);
+        for (int i = 0; i < n; i++)
+            fprintf(out, "METRIC %s %.9g %.9g %.9g %.9g\n", names[i].c_str(), min[i], max[i], sum[i] / size, sum[i]);
+        fflush(out);
+    }
+
+private:
+    std::vector<std::string> names;
+    std::vector<double> values;
+};
+
+/**
+ * Wall time of the consecutive phases of a run
+ * Every process marks the same phases in the same order, a phase lasts from the previous mark (or start) to its own mark.
+ */
+class PhaseTimer
+{
+public:
+    /**
+     * Start timing, the first phase starts here
+     */
+    void start() { last = MPI_Wtime(); }
+
+    /**
+     * Record a phase that took place before MPI_Wtime was available
+     */
+    void add(const std::string &name, double seconds)
+    {
+        names.push_back(name);
+        seconds_.push_back(seconds);
+    }
+
+    /**
+     * End the current phase
+     *
+     * @param name The name of the phase that ends now
+     */
+    void mark(const std::string &name)
+    {
+        double now = MPI_Wtime();
+        add(name, now - last);
+        last = now;
+    }
+
+    /**
+     * Reduce the phases over all processes and print them as one line on the root, collective
+     * Format: PHASES <name> <min>/<mean>/<max> ... in seconds
+     */
+    void print(MPI_Comm comm, int root, FILE *out) const
+    {
+        int rank, size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        int n = (int)seconds_.size();
+        std::vector<double> min(n), max(n), sum(n);
+        MPI_Reduce(seconds_.data(), min.data(), n, MPI_DOUBLE, MPI_MIN, root, comm);
+        MPI_Reduce(seconds_.data(), max.data(), n, MPI_DOUBLE, MPI_MAX, root, comm);
+        MPI_Reduce(seconds_.data(), sum.data(), n, MPI_DOUBLE, MPI_SUM, root, comm);
+        if (rank != root)
+            return;
+        fprintf(out, "PHASES");
+        for (int i = 0; i < n; i++)
+            fprintf(out, " %s %.4f/%.4f/%.4f", names[i].c_str(), min[i], sum[i] / size, max[i]);
+        fprintf(out, " (min/mean/max s)\n");
+        fflush(out);
+    }
+
+    /**
+     * Add every phase to a metrics report as phase_<name>_s
+     */
+    void add_to(MetricsReport &report) const
+    {
+        for (size_t i = 0; i < names.size(); i++)
+            report.add("phase_" + names[i] + "_s", seconds_[i]);
+    }
+
+private:
+    double last = 0;
+    std::vector<std::string> names;
+    std::vector<double> seconds_;
+};
+
+/**
+ * Read a "<key>: <value> kB" field from a /proc file
+ *
+ * @return The value in kB, 0 if the field is not present
+ */
+inline double read_proc_kb(const char *path, const char *key)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return 0;
+    char line[256];
+    double value = 0;
+    size_t key_length = strlen(key);
+    while (fgets(line, sizeof(line), file) != NULL)
+        if (strncmp(line, key, key_length) == 0 && line[key_length] == ':')
+        {
+            value = atof(line + key_length + 1);
+            break;
+        }
+    fclose(file);
+    return value;
+}
+
+/**
+ * Add the page and TLB related metrics of the current process to a report
+ * Page faults and huge page coverage are what decides the TLB miss rate on the large arrays
+ */
+inline void add_page_metrics(MetricsReport &report)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    LargePageState &state = large_pages();
+    report.add("max_rss_kb", usage.ru_maxrss);
+    report.add("minor_page_faults", usage.ru_minflt);
+    report.add("major_page_faults", usage.ru_majflt);
+    report.add("anon_huge_pages_kb", read_proc_kb("/proc/self/smaps_rollup", "AnonHugePages"));
+    report.add("hugetlb_allocations", state.explicit_allocations);
+    report.add("thp_allocations", state.transparent_allocations);
+    report.add("hugetlb_fallbacks", state.fallbacks);
+}
+
+#endif
@@ -0,0 +1,451 @@
+/**
+ * Protocol loop of Musaev's PDDFS algorithm and the library entry points, see pddfs.h and pddfs_driver.h
+ * Every process handles the DISCOVER, REJECT and TERMINATE messages for its vertex until the vertex terminates.
+ * The handlers are shared with the other transports (vertex_protocol.h), this file runs them over MPI.
+ */
+
+#include "pddfs_driver.h"
+#include <signal.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "compressed_adjacency.h"
+#include "handler_profile.h"
+#include "latency.h"
+#include "message_log.h"
+#include "progress.h"
+#include "protocol.h"
+#include "tree_stream.h"
+#include "vertex_protocol.h"
+
+/**
+ * Array to string for debug printing
+ */
+static std::string to_str(int n, const int arr[])
+{
+    std::string out = "[";
+    for (int i = 0; i < n; i++)
+        out += std::to_string(arr[i]) + ", ";
+    out += "]";
+    return out;
+}
+
+/**
+ * Id list to string for debug printing
+ */
+std::string to_arr(const std::vector<int> &elems)
+{
+    std::string out;
+    out.push_back('[');
+    for (auto elem : elems)
+        out.append(std::to_string(elem) + ", ");
+    out.push_back(']');
+    return out;
+}
+
+// the state is dumped from the protocol loop or the finished dump thread, never from a signal handler
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "dump requests are set from a signal handler");
+static std::atomic<int> dump_requested(0);
+
+void pddfs_request_dump()
+{
+    dump_requested = 1;
+}
+
+/**
+ * Wait for the next message, polling the progress rounds in the meantime when progress is reported
+ * The wait polls instead of blocking in MPI_Probe, so a requested state dump is served while waiting.
+ *
+ * @param source The rank to accept a message from, MPI_ANY_SOURCE unless a message log is replayed
+ * @param tag The message type to accept, MPI_ANY_TAG unless a message log is replayed
+ * @param v The state of the current vertex
+ * @param msgct The amount of messages handled so far
+ * @param progress The progress reporter, polled if enabled
+ * @param status The status of the message that arrived
+ * @param comm The communicator to probe
+ * @return true if a message arrived, false if the wait was interrupted by a dump request
+ */
+static bool wait_for_message(int source, int tag, const VertexState &v, int msgct, ProgressReporter &progress, MPI_Status &status, MPI_Comm comm)
+{
+    long values[PROGRESS_VALUES] = {v.mounted(), 0, msgct, v.parent_changes};
+    int arrived = 0;
+    while (!dump_requested)
+    {
+        MPI_Iprobe(source, tag, comm, &arrived, &status);
+        if (arrived)
+            return true;
+        if (progress.enabled())
+            progress.poll(values);
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+/**
+ * Describe the state of the current process for a dump, one "name value" line per field
+ *
+ * @param v The state of the current vertex
+ * @param msgct The amount of messages handled so far
+ * @param busy The time spent handling messages so far
+ * @param idle The time spent waiting for messages so far
+ * @param pending The sends that have not been matched yet
+ * @param waiting Whether a message is waiting to be handled
+ */
+static std::string describe_state(const VertexState &v, int msgct, double busy, double idle, size_t pending, int waiting)
+{
+    std::vector<int> open_children; // children that have not terminated, the ones the vertex is waiting for
+    for (size_t i = 0; i < v.neighbours.ids.size(); i++)
+        if ((v.neighbours.flags[i] & NEIGHBOUR_CHILD) && !(v.neighbours.flags[i] & NEIGHBOUR_TERMINATED))
+            open_children.push_back(v.neighbours.ids[i]);
+
+    char line[256];
+    std::string out;
+    snprintf(line, sizeof(line), "parent %d\nmounted %d\nparent_rejected %d\npath_length %d\n", v.parent, v.mounted(), v.parent_rejected(),
+             v.path_length);
+    out += line;
+    snprintf(line, sizeof(line), "neighbours %zu\nchildren %d\nterminated %d\n", v.neighbours.ids.size(), v.neighbours.children(),
+             v.neighbours.terminated());
+    out += line;
+    out += "open_children " + to_arr(open_children) + "\n";
+    snprintf(line, sizeof(line), "pending_sends %zu\nmessage_waiting %d\n", pending, waiting);
+    out += line;
+    snprintf(line, sizeof(line), "messages %d\nparent_changes %ld\nbusy_s %.6f\nidle_s %.6f\n", msgct, v.parent_changes, busy, idle);
+    out += line;
+    return out;
+}
+
+/**
+ * Append a dump to the dump file <prefix>.<rank> of the current process
+ *
+ * @param phase Appended to the header line
+ * @param body The state, see describe_state()
+ */
+static void append_dump(const std::string &prefix, int rank, int vertex, const char *phase, const std::string &body)
+{
+    static std::atomic<int> dumps(0);
+    std::string path = prefix + "." + std::to_string(rank);
+    FILE *out = fopen(path.c_str(), "a");
+    if (out == NULL)
+        return;
+    fprintf(out, "# dump %d of rank %d, vertex %d%s\n", ++dumps, rank, vertex, phase);
+    fputs(body.c_str(), out);
+    fclose(out);
+}
+
+/**
+ * Serves dump requests after the protocol loop has ended, while the process waits for the other processes (the progress
+ * rounds, the collectives of the caller). The vertex no longer changes then, so the loop leaves a description of its
+ * final state and a thread appends it on every request, without any MPI call.
+ */
+class FinishedDumps
+{
+public:
+    FinishedDumps() : running(false) {}
+    ~FinishedDumps() { stop(); }
+
+    void start(const char *prefix, int rank, int vertex, const std::string &body)
+    {
+        stop();
+        running = true;
+        thread = std::thread([this, prefix = std::string(prefix), rank, vertex, body]()
+                             {
+            while (running)
+            {
+                if (dump_requested.exchange(0))
+                    append_dump(prefix, rank, vertex, " (protocol finished)", body);
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            } });
+    }
+
+    /**
+     * Stop serving, the protocol loop serves the requests while it runs
+     */
+    void stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+private:
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+static FinishedDumps &finished_dumps()
+{
+    static FinishedDumps dumps;
+    return dumps;
+}
+
+/**
+ * The MPI transport of the protocol loop (vertex_protocol.h), with the instrumentation of the loop
+ * Sends go through protocol.h. A wait follows the replayed message log or records one, serves dump requests and
+ * progress rounds while nothing arrives, and accounts the time spent waiting.
+ */
+class MpiTransport
+{
+public:
+    /**
+     * What a probe found, source is a rank of comm
+     */
+    struct Status
+    {
+        int source;
+        int tag;
+        int count;
+    };
+
+    MpiTransport(const VertexState &state, MPI_Comm comm, const PddfsConfig &config, MessageLog &log, ProgressReporter &progress)
+        : messages(0), idle(0), loop_start(MPI_Wtime()), state(state), comm(comm), config(config), log(log), progress(progress)
+    {
+        MPI_Comm_rank(comm, &rank);
+    }
+
+    void wait(Status *found)
+    {
+        int source = MPI_ANY_SOURCE, tag = MPI_ANY_TAG;
+        if (log.replaying() && !log.next(&source, &tag))
+        {
+            source = MPI_ANY_SOURCE; // the run diverged from the recording, continue unordered
+            tag = MPI_ANY_TAG;
+        }
+        MPI_Status status;
+        double wait_start = MPI_Wtime();
+        bool arrived = false;
+        while (!arrived)
+        {
+            arrived = ::profiled(PROFILE_PROBE, [&]()
+                                 { return wait_for_message(source, tag, state, messages, progress, status, comm); });
+            if (dump_requested.exchange(0))
+            {
+                log.flush();
+                int waiting;
+                MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &waiting, MPI_STATUS_IGNORE);
+                append_dump(config.dump_prefix, rank, state.id, "",
+                            describe_state(state, messages, wait_start - loop_start - idle, idle + MPI_Wtime() - wait_start, pending_sends().count(), waiting));
+            }
+        }
+        idle += MPI_Wtime() - wait_start;
+        if (log.recording())
+            log.append(status.MPI_SOURCE, status.MPI_TAG);
+        messages++;
+        found->source = status.MPI_SOURCE;
+        found->tag = status.MPI_TAG;
+        MPI_Get_count(&status, MPI_INT, &found->count);
+        if (DEBUG_PRINT)
+            std::cerr << "[" << rank << "]:"
+                      << "Got " << (found->tag == DISCOVER_TYPE ? "DISCOVER" : found->tag == REJECT_TYPE ? "REJECT" : "TERMINATE")
+                      << " msg FROM: " << found->source << "\t\t" << messages << std::endl;
+    }
+
+    /**
+     * Receive the path of a DISCOVER message and record its latency
+     */
+    int receive_path(const Status &status, large_vector<int> &path)
+    {
+        fit_path(path, status.count);
+        MPI_Recv(path.data(), status.count, MPI_INT, status.source, DISCOVER_TYPE, comm, MPI_STATUS_IGNORE);
+        int path_length = status.count - stamp_ints();
+        record_latency(DISCOVER_TYPE, path.data() + path_length);
+        return path_length;
+    }
+
+    /**
+     * Receive a message without payload (REJECT or TERMINATE) and record its latency
+     */
+    void receive_control(const Status &status)
+    {
+        int stamp[MESSAGE_STAMP_INTS];
+        MPI_Recv(stamp, stamp_ints(), MPI_INT, status.source, status.tag, comm, MPI_STATUS_IGNORE);
+        record_latency(status.tag, stamp);
+    }
+
+    void send_discover(const NeighbourTable &neighbours, int dest, int path[], int path_length)
+    {
+        ::send_discover(neighbours, dest, neighbours.rank_of(dest), path, path_length, comm);
+    }
+
+    void send_reject(const NeighbourTable &neighbours, int dest) { ::send_reject(neighbours.rank_of(dest), comm); }
+
+    void send_terminate(const NeighbourTable &neighbours, int dest) { ::send_terminate(neighbours.rank_of(dest), comm); }
+
+    void terminating(const VertexState &v)
+    {
+        if (config.tree_stream >= 0 && !write_tree_record(config.tree_stream, v)) // before TERMINATE, so the subtree is in the stream before its parent
+            std::cout << "[" << v.id << "]: cannot write tree stream record" << std::endl;
+    }
+
+    void handled(const VertexState &v, const Status &)
+    {
+        if (DEBUG_PRINT)
+            std::cerr << "[" << rank << "]: "
+                      << " parent: " << v.parent << " curr-path[" << to_str(v.path_length, v.path.data()) << "]"
+                      << " with len:" << std::to_string(v.path_length) << " children: " << to_arr(v.neighbours.collect(NEIGHBOUR_CHILD))
+                      << " terminated: " << to_arr(v.neighbours.collect(NEIGHBOUR_TERMINATED)) << " parent-rejected?: " << v.parent_rejected() << std::endl
+                      << std::endl;
+    }
+
+    template <typename F>
+    auto profiled(ProfileSection section, F f) -> decltype(f())
+    {
+        return ::profiled(section, f);
+    }
+
+    int messages;      // handled so far
+    double idle;       // seconds spent waiting for messages
+    double loop_start;
+
+private:
+    const VertexState &state;
+    MPI_Comm comm;
+    int rank;
+    const PddfsConfig &config;
+    MessageLog &log;
+    ProgressReporter &progress;
+};
+
+void pddfs_protocol(VertexState &state, const uint8_t *row, MPI_Comm comm, const PddfsConfig &config, PddfsStats *stats)
+{
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    finished_dumps().stop();
+
+    MessageLog log;
+    if (config.record_prefix != NULL && !log.record(MessageLog::path(config.record_prefix, rank)))
+        std::cout << "[" << state.id << "]: cannot record to " << MessageLog::path(config.record_prefix, rank) << std::endl;
+    if (config.replay_prefix != NULL && !log.replay(MessageLog::path(config.replay_prefix, rank)))
+        std::cout << "[" << state.id << "]: cannot replay " << MessageLog::path(config.replay_prefix, rank) << std::endl;
+    ProgressReporter progress;
+    if (config.progress > 0)
+        progress.start(config.progress, comm);
+    MpiTransport transport(state, comm, config, log, progress);
+    int msgct = run_vertex(transport, state, row);
+
+    double busy = MPI_Wtime() - transport.loop_start - transport.idle;
+    log.close();
+    int waiting;
+    MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &waiting, MPI_STATUS_IGNORE);
+    finished_dumps().start(config.dump_prefix, rank, state.id, describe_state(state, msgct, busy, transport.idle, pending_sends().count(), waiting));
+    if (log.replaying() && !log.matched())
+        std::cout << "[" << state.id << "]: replay diverged from the recorded message order" << std::endl;
+    if (progress.enabled())
+    {
+        long values[PROGRESS_VALUES] = {state.mounted(), 1, msgct, state.parent_changes};
+        while (!progress.done())
+        {
+            progress.poll(values); // keep joining rounds until every process has terminated
+            std::this_thread::yield();
+        }
+        progress.stop();
+    }
+    if (stats != NULL)
+    {
+        stats->messages = msgct;
+        stats->busy = busy;
+        stats->idle = transport.idle;
+    }
+}
+
+/**
+ * Receive and drop the messages sent to vertices that had already terminated, collective over comm
+ * Such messages are never handled, so their synchronous sends never complete. Every process keeps draining its queue
+ * until all processes have seen all their sends matched, after that no send of the run is pending on comm.
+ */
+static void drain_unmatched(MPI_Comm comm)
+{
+    MPI_Request barrier = MPI_REQUEST_NULL;
+    int all_matched = 0;
+    std::vector<int> discarded;
+    while (!all_matched)
+    {
+        int waiting;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, comm, &waiting, &status);
+        if (waiting)
+        {
+            int count;
+            MPI_Get_count(&status, MPI_INT, &count);
+            discarded.resize(count);
+            MPI_Recv(discarded.data(), count, MPI_INT, status.MPI_SOURCE, status.MPI_TAG, comm, MPI_STATUS_IGNORE);
+            continue;
+        }
+        if (barrier == MPI_REQUEST_NULL)
+        {
+            if (pending_sends().count() == 0) // entered once every own send is matched
+                MPI_Ibarrier(comm, &barrier);
+        }
+        else
+            MPI_Test(&barrier, &all_matched, MPI_STATUS_IGNORE);
+        std::this_thread::yield();
+    }
+}
+
+bool pddfs_run(MPI_Comm comm, const int *neighbours, int degree, int *parent, std::vector<int> *children, PddfsStats *stats,
+               const int *keys)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int valid = 1;
+    for (int i = 0; i < degree; i++)
+        valid &= neighbours[i] >= 0 && neighbours[i] < size && (keys == NULL || keys[i] >= 0);
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_LAND, comm); // every process has to leave together
+    if (!valid)
+        return false;
+    int keyed = keys != NULL;
+    MPI_Allreduce(MPI_IN_PLACE, &keyed, 1, MPI_INT, MPI_LOR, comm); // all paths of a run have the same layout
+
+    std::vector<int> list(neighbours, neighbours + degree);
+    std::vector<int> key_list;
+    if (keys != NULL)
+        key_list.assign(keys, keys + degree);
+    CompressedAdjacency row;
+    row.keyed = keyed;
+    row.add_row(0, list, keys != NULL ? &key_list : NULL);
+    MPI_Comm local;
+    MPI_Comm_dup(comm, &local);
+    VertexIds ids;
+    // the instrumentation describes the last call, nothing of an earlier call is counted again
+    comm_matrix().rows.clear();
+    for (LatencyHistogram &histogram : message_latency().histograms)
+        histogram = LatencyHistogram();
+    // paths have room for every vertex and the latency stamp
+    VertexState state(rank, path_entry_ints(keyed) * size + MESSAGE_STAMP_INTS, ids);
+    pddfs_protocol(state, row.bytes.data(), local, PddfsConfig(), stats);
+    drain_unmatched(local);
+    message_latency().control_stamps.clear(); // every send has completed, no stamp is read any more
+    message_latency().free_stamps.clear();
+    MPI_Comm_free(&local);
+
+    *parent = state.id == 0 ? -1 : state.parent;
+    *children = state.neighbours.collect(NEIGHBOUR_CHILD);
+    return true;
+}
+
+bool pddfs_run_csr(MPI_Comm comm, int n, const int64_t *offsets, const int *targets, PddfsTree *tree, PddfsStats *stats)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    if (n != size)
+        return false; // every process got the same n, so every process leaves here
+
+    int parent;
+    std::vector<int> children;
+    if (!pddfs_run(comm, targets + offsets[rank], (int)(offsets[rank + 1] - offsets[rank]), &parent, &children, stats))
+        return false;
+
+    int count = (int)children.size();
+    std::vector<int> counts(size);
+    tree->parent.resize(size);
+    MPI_Allgather(&parent, 1, MPI_INT, tree->parent.data(), 1, MPI_INT, comm);
+    MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm);
+    tree->child_offsets.assign(size + 1, 0);
+    for (int v = 0; v < size; v++)
+        tree->child_offsets[v + 1] = tree->child_offsets[v] + counts[v];
+    tree->children.resize(tree->child_offsets[size]);
+    MPI_Allgatherv(children.data(), count, MPI_INT, tree->children.data(), counts.data(), tree->child_offsets.data(), MPI_INT, comm);
+    return true;
+}
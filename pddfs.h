@@ -0,0 +1,75 @@
+/**
+ * Library interface of Musaev's Parallel Distributed Depth First Search algorithm
+ * The algorithm runs with one process per vertex: vertex v is hosted by rank v of the communicator passed in, and vertex 0
+ * is the root of the DFS tree. Applications that already hold their graph in memory call pddfs_run() with the neighbours of
+ * the vertex of every process, or pddfs_run_csr() with a CSR graph, instead of writing the graph as text for the pddfs program.
+ * Every call works on a private duplicate of the communicator, so its messages never mix with those of the application,
+ * and returns only after every message of the call has been received, so calls can be repeated on the same processes.
+ * The communication matrix and latency histograms (comm_matrix.h, latency.h) describe the last call.
+ * Graphs must be undirected (every edge stored in both directions) and connected, like for the pddfs program.
+ *
+ * The protocol loop itself, for drivers that load and place the graph themselves, is declared in pddfs_driver.h.
+ *
+ * Link with the pddfs library target, see CMakeLists.txt.
+ */
+
+#ifndef PDDFS_H
+#define PDDFS_H
+
+#include <mpi.h>
+#include <cstdint>
+#include <vector>
+
+/**
+ * What one process did during the protocol loop
+ */
+struct PddfsStats
+{
+    int messages = 0; // messages handled
+    double busy = 0;  // seconds spent handling messages
+    double idle = 0;  // seconds spent waiting for messages
+};
+
+/**
+ * DFS tree of all vertices
+ */
+struct PddfsTree
+{
+    std::vector<int> parent;        // parent[v], -1 for the root
+    std::vector<int> child_offsets; // the children of v are children[child_offsets[v]] .. children[child_offsets[v + 1] - 1]
+    std::vector<int> children;
+};
+
+/**
+ * Compute the DFS tree from the neighbour list of every vertex, collective over comm
+ *
+ * @param comm One process per vertex, the current process hosts the vertex with its rank
+ * @param neighbours The neighbours of the vertex of the current process, in any order
+ * @param degree The amount of neighbours
+ * @param parent Written with the parent of the vertex, -1 for the root
+ * @param children Written with the children of the vertex in ascending order
+ * @param stats Written with the work of the current process, may be NULL
+ * @param keys The ordering key (non-negative) of the edge to every neighbour, the DFS explores lower keys first, may be NULL.
+ *             When any process passes keys, processes without them use key 0. The tree is only reproducible when the
+ *             message order is: a vertex that adopts a better path does not pass it on to its children, so when competing
+ *             paths race the tree can differ between runs and from the sequential DFS in (key, ID) order. Equal keys, as
+ *             with few distinct weights, make such races common. See the README for the runs that are reproducible.
+ * @return false if a neighbour is not a rank of comm
+ */
+bool pddfs_run(MPI_Comm comm, const int *neighbours, int degree, int *parent, std::vector<int> *children, PddfsStats *stats = NULL,
+               const int *keys = NULL);
+
+/**
+ * Compute the DFS tree of a CSR graph, collective over comm, every process passes the same graph and gets the whole tree
+ *
+ * @param comm One process per vertex
+ * @param n The amount of vertices, must equal the size of comm
+ * @param offsets The neighbours of v are targets[offsets[v]] .. targets[offsets[v + 1] - 1]
+ * @param targets The concatenated neighbour lists
+ * @param tree Written with the DFS tree
+ * @param stats Written with the work of the current process, may be NULL
+ * @return false if n does not match the size of comm or a neighbour is out of range
+ */
+bool pddfs_run_csr(MPI_Comm comm, int n, const int64_t *offsets, const int *targets, PddfsTree *tree, PddfsStats *stats = NULL);
+
+#endif
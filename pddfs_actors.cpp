@@ -0,0 +1,200 @@
+/**
+ * Musaev's PDDFS algorithm with every vertex as a coroutine actor in one process
+ * The MPI program runs one process per vertex, which limits it to graphs of as many vertices as the job has processes.
+ * Here every vertex is an actor of the runtime in actor_runtime.h: the handlers are the same as in pddfs (vertex_protocol.h),
+ * called from a loop that co_awaits the next message, and the actors are multiplexed over a few threads. A vertex costs its
+ * coroutine frame, its neighbour table and its path, so a single process can host millions of vertices.
+ *
+ * Input is the same as for the pddfs program: edges on STDIN, or a mapped CSR file with --csr.
+ * Output is the same DONE line per vertex (suppressed with --quiet), followed by a summary:
+ *   ACTORS vertices <n> threads <t> finished <f> messages <m> seconds <s> frame_bytes <b>
+ * When the run stops without every vertex finishing (no message left to handle), the unfinished vertices are counted
+ * in a STALLED line and the exit status is 1.
+ *
+ * usage: pddfs_actors [--threads <n>] [--csr <mapped csr file>] [--quiet] [< edges]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "actor_runtime.h"
+#include "compressed_adjacency.h"
+#include "mapped_csr.h"
+#include "vertex_protocol.h"
+
+/**
+ * What a vertex knows when it finishes
+ */
+struct ActorResult
+{
+    bool finished = false;
+    int parent = -1;
+    int messages = 0;
+    std::vector<int> children;
+};
+
+/**
+ * The actor transport of the protocol (vertex_protocol.h), actors are addressed by vertex ID
+ * The actor awaits its messages itself and hands each one to receive() before it is handled.
+ */
+class ActorTransport : public BasicTransport
+{
+public:
+    struct Status
+    {
+        int source;
+        int tag;
+        int count;
+    };
+
+    ActorTransport(ActorSystem &system, int id) : system(system), id(id), current(NULL) {}
+
+    /**
+     * @return The status of a message the actor has received, its payload is read by the handlers
+     */
+    Status receive(ActorMessage *m)
+    {
+        current = m;
+        return Status{m->source, m->type, (int)m->payload.size()};
+    }
+
+    int receive_path(const Status &status, large_vector<int> &path)
+    {
+        fit_path(path, status.count);
+        std::copy(current->payload.begin(), current->payload.end(), path.begin());
+        return status.count;
+    }
+
+    void receive_control(const Status &) {}
+
+    void send_discover(const NeighbourTable &neighbours, int dest, int path[], int path_length)
+    {
+        ActorMessage *m = message(DISCOVER_TYPE);
+        m->payload.assign(path, path + neighbours.append_hop(path, path_length, dest));
+        system.send(dest, m);
+    }
+
+    void send_reject(const NeighbourTable &, int dest) { system.send(dest, message(REJECT_TYPE)); }
+
+    void send_terminate(const NeighbourTable &, int dest) { system.send(dest, message(TERMINATE_TYPE)); }
+
+private:
+    ActorMessage *message(int type)
+    {
+        ActorMessage *m = system.message();
+        m->source = id;
+        m->type = type;
+        return m;
+    }
+
+    ActorSystem &system;
+    int id;
+    ActorMessage *current;
+};
+
+/**
+ * The protocol of one vertex, the loop of run_vertex() (vertex_protocol.h) with the wait as a co_await
+ * The path buffers start small and grow with the paths, so a vertex does not hold room for a path through the whole graph.
+ *
+ * @param system The runtime the vertex lives in
+ * @param id The vertex
+ * @param row The compressed neighbour row of the vertex, materialised into the neighbour table on mount
+ * @param ids Identity translation, actors are addressed by vertex ID
+ * @param result Written when the vertex terminates
+ */
+ActorTask vertex_actor(ActorSystem &system, int id, const uint8_t *row, const VertexIds &ids, ActorResult *result)
+{
+    VertexState state(id, 0, ids);
+    ActorTransport transport(system, id);
+    int messages = 0;
+    start_vertex(transport, state, row);
+    while (!finish_vertex(transport, state))
+    {
+        ActorMessage *m = co_await system.receive(id);
+        messages++;
+        handle_message(transport, state, row, transport.receive(m));
+        system.release(m);
+    }
+
+    result->finished = true;
+    result->parent = state.parent;
+    result->messages = messages;
+    result->children = state.neighbours.collect(NEIGHBOUR_CHILD);
+    system.finish(id);
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = 1;
+    const char *csr_path = NULL;
+    bool quiet = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            threads = atoi(argv[++i]);
+        else if (arg == "--csr" && i + 1 < argc)
+            csr_path = argv[++i];
+        else if (arg == "--quiet")
+            quiet = true;
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [--threads <n>] [--csr <mapped csr file>] [--quiet] [< edges]" << std::endl;
+            return 1;
+        }
+    }
+
+    CompressedAdjacency adjacency;
+    MappedCsr mapped;
+    AdjacencyView graph;
+    if (csr_path != NULL)
+    {
+        if (!mapped.open(csr_path) || !mapped.valid_rows()) // every row is decoded in this process
+        {
+            std::cerr << "could not map " << csr_path << std::endl;
+            return 1;
+        }
+        graph = mapped.view();
+    }
+    else
+    {
+        read_edge_list(std::cin, adjacency);
+        graph = adjacency.view();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    VertexIds ids;
+    std::vector<ActorResult> results(graph.n);
+    long finished;
+    size_t frame_bytes;
+    {
+        ActorSystem system(graph.n, threads);
+        for (int v = 0; v < graph.n; v++)
+            system.spawn(v, [&, v]()
+                         { return vertex_actor(system, v, graph.bytes + graph.offsets[v], ids, &results[v]); });
+        system.run();
+        finished = system.finished_actors();
+        frame_bytes = system.frame_bytes();
+        threads = system.threads();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    long messages = 0;
+    for (int v = 0; v < graph.n; v++)
+    {
+        messages += results[v].messages;
+        if (quiet || !results[v].finished)
+            continue;
+        std::string children = "[";
+        for (int child : results[v].children)
+            children += std::to_string(child) + ", ";
+        printf("[%d]:\t DONE - Children: %s]\t\t%d\n", v, children.c_str(), results[v].messages);
+    }
+    printf("ACTORS vertices %d threads %d finished %ld messages %ld seconds %.6f frame_bytes %zu\n", graph.n, threads, finished,
+           messages, seconds, frame_bytes);
+    if (finished < graph.n)
+        printf("STALLED %ld vertices did not finish\n", graph.n - finished);
+    return finished == graph.n ? 0 : 1;
+}
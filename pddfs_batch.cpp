@@ -0,0 +1,303 @@
+/**
+ * Batch mode of the PDDFS algorithm: many small graphs in one MPI job
+ * Launching a job per graph costs far more than the search on a graph of a few hundred vertices, so this program reads
+ * a stream of graphs and runs as many of them side by side as the processes allow. The algorithm needs one process per
+ * vertex: rank 0 coordinates, every other rank is a worker. The coordinator reads the graphs one at a time, keeps a window
+ * of up to BATCH_WINDOW waiting graphs and starts every waiting graph that fits into the idle workers (first fit in input
+ * order). The workers of a graph form a communicator of their own and run the library (pddfs.h) on it, the first of them
+ * sends the tree back. As soon as a graph is done its workers are idle again and the next graphs start on them, so a slow
+ * graph only holds its own workers. A graph that does not fit is passed over by later graphs at most BATCH_MAX_OVERTAKES
+ * times, after that no later graph starts until it has started, so large graphs are not starved by a stream of small ones.
+ *
+ * Input on STDIN: every graph starts with a line "graph <id> <vertices>", followed by its edges as for the pddfs program
+ * (one "<u> <v>" line per direction, vertices numbered from 0). Graphs must be connected: the protocol never terminates
+ * when a vertex cannot be reached from vertex 0, and its workers would stay busy for good, so such graphs are not run.
+ * Output on STDOUT, written by the coordinator as soon as a graph is done, tab separated fields:
+ *   <graph id>\t<vertex>\t<parent>\t<children, comma separated>   one line per vertex, the lines of a graph are written together
+ *   <graph id>\tskipped                                           a graph without vertices, with more vertices than workers
+ *                                                                  or with vertices that cannot be reached from vertex 0
+ *
+ * usage: mpirun -np <processes> pddfs_batch < graphs
+ */
+
+#include <mpi.h>
+#include <cstdio>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "pddfs.h"
+
+#define BATCH_WINDOW 256       // waiting graphs the coordinator reads ahead
+#define BATCH_MAX_OVERTAKES 64 // later graphs that may start before the oldest waiting graph
+#define BATCH_ASSIGN 1         // coordinator to worker: the graph, vertex and neighbours to run
+#define BATCH_STOP 2           // coordinator to worker: no more graphs
+#define BATCH_RESULT 3         // first worker of a graph to coordinator: the tree
+
+struct BatchGraph
+{
+    std::string id;
+    int sequence = 0;
+    std::vector<std::vector<int>> neighbours;
+    std::vector<int> ranks; // the workers running the graph, ranks[v] hosts vertex v
+    int overtaken = 0;      // later graphs that started while this one waited
+};
+
+/**
+ * Reads the graphs of a stream one at a time
+ */
+class GraphReader
+{
+public:
+    explicit GraphReader(std::istream &in) : in(in), sequence(0) {}
+
+    /**
+     * Read the next graph, edges that refer to vertices outside their graph and lines before the first graph are dropped
+     *
+     * @return false at the end of the stream
+     */
+    bool next(BatchGraph *graph)
+    {
+        std::string line;
+        while (header.empty() && std::getline(in, line))
+            if (is_header(line))
+                header = line;
+        if (header.empty())
+            return false;
+
+        std::istringstream fields(header);
+        std::string word;
+        int n = 0;
+        graph->id.clear();
+        fields >> word >> graph->id >> n;
+        graph->sequence = sequence++;
+        graph->neighbours.assign(n > 0 ? n : 0, std::vector<int>());
+        header.clear();
+        while (std::getline(in, line))
+        {
+            if (is_header(line))
+            {
+                header = line; // the start of the next graph
+                break;
+            }
+            int u, v;
+            if (sscanf(line.c_str(), "%i %i", &u, &v) == 2 && u >= 0 && u < n && v >= 0 && v < n)
+                graph->neighbours[u].push_back(v);
+        }
+        return true;
+    }
+
+private:
+    static bool is_header(const std::string &line)
+    {
+        std::istringstream fields(line);
+        std::string word;
+        return fields >> word && word == "graph";
+    }
+
+    std::istream &in;
+    std::string header; // the header line of the next graph, read while reading the previous one
+    int sequence;
+};
+
+/**
+ * Check that every vertex of a graph can be reached from vertex 0 along its edges
+ */
+bool is_connected(const BatchGraph &graph)
+{
+    int n = (int)graph.neighbours.size();
+    std::vector<bool> reached(n, false);
+    std::vector<int> queue(1, 0);
+    reached[0] = true;
+    for (size_t head = 0; head < queue.size(); head++)
+        for (int w : graph.neighbours[queue[head]])
+            if (!reached[w])
+            {
+                reached[w] = true;
+                queue.push_back(w);
+            }
+    return (int)queue.size() == n;
+}
+
+/**
+ * Run the graphs the coordinator assigns to the current worker until it is stopped
+ */
+void run_worker()
+{
+    MPI_Group world_group;
+    MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    while (1)
+    {
+        MPI_Status status;
+        MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        int count;
+        MPI_Get_count(&status, MPI_INT, &count);
+        std::vector<int> assignment(count); // sequence, vertex, n, the n ranks of the graph, the neighbours of the vertex
+        MPI_Recv(assignment.data(), count, MPI_INT, 0, status.MPI_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        if (status.MPI_TAG == BATCH_STOP)
+            break;
+
+        int sequence = assignment[0], n = assignment[2];
+        MPI_Group graph_group;
+        MPI_Comm graph_comm;
+        MPI_Group_incl(world_group, n, assignment.data() + 3, &graph_group);
+        MPI_Comm_create_group(MPI_COMM_WORLD, graph_group, sequence % 32768, &graph_comm); // only the workers of the graph take part
+        MPI_Group_free(&graph_group);
+
+        int parent;
+        std::vector<int> children;
+        pddfs_run(graph_comm, assignment.data() + 3 + n, count - 3 - n, &parent, &children);
+
+        // the first worker gathers the tree and sends it to the coordinator: sequence, parents, child counts, children
+        int rank, count_children = (int)children.size();
+        MPI_Comm_rank(graph_comm, &rank);
+        std::vector<int> result(rank == 0 ? 1 + 2 * n : 0), displs(rank == 0 ? n : 0);
+        MPI_Gather(&parent, 1, MPI_INT, result.data() + (rank == 0 ? 1 : 0), 1, MPI_INT, 0, graph_comm);
+        MPI_Gather(&count_children, 1, MPI_INT, result.data() + (rank == 0 ? 1 + n : 0), 1, MPI_INT, 0, graph_comm);
+        int total = 0;
+        if (rank == 0)
+        {
+            result[0] = sequence;
+            for (int v = 0; v < n; v++)
+            {
+                displs[v] = total;
+                total += result[1 + n + v];
+            }
+            result.resize(1 + 2 * n + total);
+        }
+        MPI_Gatherv(children.data(), count_children, MPI_INT, result.data() + (rank == 0 ? 1 + 2 * n : 0), result.data() + (rank == 0 ? 1 + n : 0),
+                    displs.data(), MPI_INT, 0, graph_comm);
+        if (rank == 0)
+            MPI_Send(result.data(), (int)result.size(), MPI_INT, 0, BATCH_RESULT, MPI_COMM_WORLD);
+        MPI_Comm_free(&graph_comm);
+    }
+    MPI_Group_free(&world_group);
+}
+
+/**
+ * Start a graph on idle workers, one assignment per vertex
+ *
+ * @param graph The graph, its ranks are written
+ * @param idle The idle workers, the lowest ranks are taken so a graph stays on as few machines as possible
+ */
+void start_graph(BatchGraph &graph, std::set<int> &idle)
+{
+    int n = (int)graph.neighbours.size();
+    graph.ranks.clear();
+    for (int v = 0; v < n; v++)
+    {
+        graph.ranks.push_back(*idle.begin());
+        idle.erase(idle.begin());
+    }
+    std::vector<int> assignment;
+    for (int v = 0; v < n; v++)
+    {
+        assignment.assign({graph.sequence, v, n});
+        assignment.insert(assignment.end(), graph.ranks.begin(), graph.ranks.end());
+        assignment.insert(assignment.end(), graph.neighbours[v].begin(), graph.neighbours[v].end());
+        MPI_Send(assignment.data(), (int)assignment.size(), MPI_INT, graph.ranks[v], BATCH_ASSIGN, MPI_COMM_WORLD);
+    }
+    graph.neighbours.clear(); // only the sizes are needed from here on
+    graph.neighbours.resize(n);
+}
+
+/**
+ * Wait for the tree of one running graph, write it and release its workers
+ */
+void finish_graph(std::map<int, BatchGraph> &running, std::set<int> &idle)
+{
+    MPI_Status status;
+    MPI_Probe(MPI_ANY_SOURCE, BATCH_RESULT, MPI_COMM_WORLD, &status);
+    int count;
+    MPI_Get_count(&status, MPI_INT, &count);
+    std::vector<int> result(count);
+    MPI_Recv(result.data(), count, MPI_INT, status.MPI_SOURCE, BATCH_RESULT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    auto it = running.find(result[0]);
+    const BatchGraph &graph = it->second;
+    int n = (int)graph.neighbours.size();
+    const int *parents = result.data() + 1, *counts = parents + n, *children = counts + n;
+    std::string out;
+    for (int v = 0; v < n; v++)
+    {
+        out += graph.id + "\t" + std::to_string(v) + "\t" + std::to_string(parents[v]) + "\t";
+        for (int i = 0; i < counts[v]; i++)
+            out += (i > 0 ? "," : "") + std::to_string(*children++);
+        out += "\n";
+    }
+    fwrite(out.data(), 1, out.size(), stdout); // one write per graph
+    fflush(stdout);
+    idle.insert(graph.ranks.begin(), graph.ranks.end());
+    running.erase(it);
+}
+
+/**
+ * Read, schedule and collect all graphs of the input, then stop the workers
+ */
+void run_coordinator(int size)
+{
+    GraphReader reader(std::cin);
+    int workers = size - 1;
+    std::set<int> idle;
+    for (int r = 1; r < size; r++)
+        idle.insert(r);
+    std::deque<BatchGraph> waiting;
+    std::map<int, BatchGraph> running;
+    bool input_left = true;
+    while (1)
+    {
+        while (input_left && waiting.size() < BATCH_WINDOW)
+        {
+            BatchGraph graph;
+            if (!reader.next(&graph))
+                input_left = false;
+            else if (graph.neighbours.empty() || (int)graph.neighbours.size() > workers || !is_connected(graph))
+            {
+                printf("%s\tskipped\n", graph.id.c_str());
+                fflush(stdout);
+            }
+            else
+                waiting.push_back(std::move(graph));
+        }
+
+        for (auto it = waiting.begin(); it != waiting.end();)
+        {
+            if (it->neighbours.size() <= idle.size())
+            {
+                if (it != waiting.begin())
+                    waiting.front().overtaken++;
+                start_graph(*it, idle);
+                int sequence = it->sequence;
+                running.emplace(sequence, std::move(*it));
+                it = waiting.erase(it);
+            }
+            else if (it == waiting.begin() && it->overtaken >= BATCH_MAX_OVERTAKES)
+                break; // the idle workers are reserved for the oldest graph
+            else
+                ++it;
+        }
+
+        if (running.empty()) // every waiting graph fits into the idle workers, so nothing waits and the input is done
+            break;
+        finish_graph(running, idle);
+    }
+    for (int r = 1; r < size; r++)
+        MPI_Send(NULL, 0, MPI_INT, r, BATCH_STOP, MPI_COMM_WORLD);
+}
+
+int main(int argc, char *argv[])
+{
+    int rank, size;
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (rank == 0)
+        run_coordinator(size);
+    else
+        run_worker();
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,55 @@
+/**
+ * Driver interface of the PDDFS protocol loop, for programs that load and place the graph themselves (Musaev-PDDFS.cpp)
+ * Not part of the library interface in pddfs.h: it exposes the internal vertex state (vertex_state.h).
+ * The instrumentation that is switched on through the process-wide states (handler_profile(), message_latency(),
+ * comm_matrix()) applies to every call of pddfs_protocol().
+ */
+
+#ifndef PDDFS_DRIVER_H
+#define PDDFS_DRIVER_H
+
+#include <mpi.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "pddfs.h"
+#include "vertex_state.h"
+
+#define DEBUG_PRINT false // toggle debug printing to stderr
+
+/**
+ * Settings of the protocol loop, the defaults give a plain run
+ */
+struct PddfsConfig
+{
+    double progress = 0;                    // seconds between PROGRESS lines on rank 0, 0 for none (progress.h)
+    const char *record_prefix = NULL;       // log the handled message order to <prefix>.<rank> (message_log.h)
+    const char *replay_prefix = NULL;       // handle messages in the order logged in <prefix>.<rank>
+    const char *dump_prefix = "pddfs-dump"; // a dump request appends the state of every process to <prefix>.<rank>
+    int tree_stream = -1;                   // descriptor the final record of the vertex is appended to on termination, -1 for none (tree_stream.h)
+};
+
+/**
+ * Id list to string for debug printing
+ */
+std::string to_arr(const std::vector<int> &elems);
+
+/**
+ * Ask the process to dump its state, async-signal-safe
+ * A running protocol loop dumps its current state, after the loop has ended a thread dumps the final state of the vertex.
+ */
+void pddfs_request_dump();
+
+/**
+ * Run the protocol for the vertex of the current process until it terminates, collective over comm
+ * The process hosting vertex 0 starts the search.
+ *
+ * @param state The state of the vertex, holds the parent and children afterwards
+ * @param row The compressed neighbour row of the vertex (compressed_adjacency.h)
+ * @param comm The communicator the protocol messages are sent on, ranks as translated by state.ids
+ * @param config Settings of the loop
+ * @param stats Written with the work of the current process, may be NULL
+ */
+void pddfs_protocol(VertexState &state, const uint8_t *row, MPI_Comm comm, const PddfsConfig &config, PddfsStats *stats);
+
+#endif
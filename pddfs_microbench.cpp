@@ -0,0 +1,400 @@
+/**
+* Microbenchmarks for the hot operations of the PDDFS algorithm
+* Every benchmark runs a number of warmup repetitions, then timed repetitions of a fixed amount of operations,
+* and reports the median, minimum and maximum time per operation over the timed repetitions.
+* Each process is pinned to its own core before anything is measured.
+*
+* Run on two processes to include the MPI ping-pong benchmarks: mpirun -np 2 ./pddfs_microbench
+* Options:
+*   --reps <n>       timed repetitions per benchmark (default 15)
+*   --warmup <n>     untimed repetitions per benchmark (default 3)
+*   --filter <text>  only run benchmarks whose name contains text
+*   --tsv            print every timed repetition as "scenario metric value" rows for the benchmark harness (bench/)
+*/
+
+#include <mpi.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "compressed_adjacency.h"
+#include "placement.h"
+#include "protocol.h"
+#include "vertex_state.h"
+
+using namespace std;
+
+struct BenchOptions
+{
+    int reps = 15;
+    int warmup = 3;
+    string filter;
+    bool tsv = false;
+};
+
+struct BenchResult
+{
+    string name;
+    vector<double> ns_per_op; // one entry per timed repetition
+};
+
+static volatile long sink; // results are written here so the compiler cannot drop the measured work
+
+/**
+ * Time a benchmark body
+ *
+ * @param name The name of the benchmark
+ * @param ops The amount of operations one call of body performs
+ * @param body Performs ops operations
+ * @return The time per operation of every timed repetition
+ */
+template <typename F>
+BenchResult measure(const BenchOptions &options, const string &name, long ops, F body)
+{
+    BenchResult result;
+    result.name = name;
+    for (int i = 0; i < options.warmup; i++)
+        body();
+    for (int i = 0; i < options.reps; i++)
+    {
+        auto start = chrono::steady_clock::now();
+        body();
+        auto end = chrono::steady_clock::now();
+        result.ns_per_op.push_back(chrono::duration<double, nano>(end - start).count() / ops);
+    }
+    return result;
+}
+
+void print_result(const BenchOptions &options, const BenchResult &result)
+{
+    if (options.tsv)
+    {
+        for (double ns : result.ns_per_op)
+            printf("micro/%s\tns_per_op\t%.4f\n", result.name.c_str(), ns);
+        fflush(stdout);
+        return;
+    }
+    vector<double> sorted = result.ns_per_op;
+    sort(sorted.begin(), sorted.end());
+    printf("%-40s %12.2f %12.2f %12.2f\n", result.name.c_str(), sorted[sorted.size() / 2], sorted.front(), sorted.back());
+    fflush(stdout);
+}
+
+bool selected(const BenchOptions &options, const string &name)
+{
+    return options.filter.empty() || name.find(options.filter) != string::npos;
+}
+
+/**
+ * path_order() on two paths of equal length that first differ at the given position
+ */
+void bench_path_order(const BenchOptions &options, vector<BenchResult> &results)
+{
+    const long ops = 100000;
+    for (int length : {8, 64, 1024})
+        for (int divergence : {0, length / 2, length})
+        {
+            string name = "path_order/len=" + to_string(length) + "/diverge=" + to_string(divergence);
+            if (!selected(options, name))
+                continue;
+            vector<int> a(length), b(length);
+            for (int i = 0; i < length; i++)
+                a[i] = b[i] = i;
+            if (divergence < length)
+                b[divergence]++;
+            results.push_back(measure(options, name, ops, [&]()
+                                      {
+                long total = 0;
+                for (long i = 0; i < ops; i++)
+                    total += path_order(length, a.data(), length, b.data());
+                sink = total; }));
+        }
+}
+
+/**
+ * Copying a received path into the current path, as done on every path update
+ */
+void bench_path_copy(const BenchOptions &options, vector<BenchResult> &results)
+{
+    const long ops = 100000;
+    for (int length : {8, 64, 1024})
+    {
+        string name = "path_copy/len=" + to_string(length);
+        if (!selected(options, name))
+            continue;
+        vector<int> from(length + 1, 1), to(length + 1);
+        results.push_back(measure(options, name, ops, [&]()
+                                  {
+            for (long i = 0; i < ops; i++)
+            {
+                from[0] = (int)i;
+                copy(from.begin(), from.begin() + length, to.begin());
+            }
+            sink = to[0]; }));
+    }
+}
+
+/**
+ * Child set operations on the neighbour table: erase, insert and lookup of random neighbours
+ */
+void bench_child_set(const BenchOptions &options, vector<BenchResult> &results)
+{
+    const long ops = 100000;
+    for (int degree : {4, 64, 1024})
+    {
+        vector<int> neighbours;
+        for (int i = 0; i < degree; i++)
+            neighbours.push_back(i * 3);
+        CompressedAdjacency adjacency;
+        adjacency.add_row(0, neighbours);
+        VertexIds ids;
+        NeighbourTable table;
+        table.assign(adjacency.bytes.data(), ids);
+        vector<int> probes(ops);
+        mt19937 random(42);
+        for (long i = 0; i < ops; i++)
+            probes[i] = neighbours[random() % degree];
+
+        string suffix = "/degree=" + to_string(degree);
+        if (selected(options, "child_set/erase_insert" + suffix))
+            results.push_back(measure(options, "child_set/erase_insert" + suffix, ops, [&]()
+                                      {
+                for (long i = 0; i < ops; i++)
+                {
+                    table.erase_child(probes[i]);
+                    table.insert_child(probes[i]);
+                }
+                sink = table.children(); }));
+        if (selected(options, "child_set/lookup" + suffix))
+            results.push_back(measure(options, "child_set/lookup" + suffix, ops, [&]()
+                                      {
+                long total = 0;
+                for (long i = 0; i < ops; i++)
+                    total += table.rank_of(probes[i]);
+                sink = total; }));
+        if (selected(options, "child_set/termination_check" + suffix))
+            results.push_back(measure(options, "child_set/termination_check" + suffix, ops, [&]()
+                                      {
+                long total = 0;
+                for (long i = 0; i < ops; i++)
+                {
+                    table.mark_terminated(probes[i]);
+                    total += table.all_children_terminated();
+                }
+                sink = total; }));
+    }
+}
+
+/**
+ * Parsing an edge list into a compressed adjacency, per edge
+ */
+void bench_edge_parsing(const BenchOptions &options, vector<BenchResult> &results)
+{
+    const char *name = "edge_parsing/per_edge";
+    if (!selected(options, name))
+        return;
+    const int vertices = 2000, degree = 50;
+    ostringstream text;
+    mt19937 random(42);
+    for (int v = 0; v < vertices; v++)
+        for (int i = 0; i < degree; i++)
+            text << v << " " << random() % vertices << "\n";
+    string input = text.str();
+    results.push_back(measure(options, name, (long)vertices * degree, [&]()
+                              {
+        istringstream in(input);
+        CompressedAdjacency adjacency;
+        read_edge_list(in, adjacency);
+        sink = adjacency.bytes.size(); }));
+}
+
+/**
+ * Packing a neighbour row (gap coding) and unpacking it, per element, and assembling a DISCOVER message, per message
+ */
+void bench_pack(const BenchOptions &options, vector<BenchResult> &results)
+{
+    const long rows = 1000;
+    for (int degree : {8, 256})
+    {
+        vector<int> row(degree);
+        for (int i = 0; i < degree; i++)
+            row[i] = i * 7;
+        CompressedAdjacency packed;
+        packed.add_row(0, row);
+
+        string suffix = "/degree=" + to_string(degree);
+        if (selected(options, "row_pack" + suffix))
+            results.push_back(measure(options, "row_pack" + suffix, rows * degree, [&]()
+                                      {
+                CompressedAdjacency adjacency;
+                for (long r = 0; r < rows; r++)
+                    adjacency.add_row((int)r, row);
+                sink = adjacency.bytes.size(); }));
+        if (selected(options, "row_unpack" + suffix))
+            results.push_back(measure(options, "row_unpack" + suffix, rows * degree, [&]()
+                                      {
+                long total = 0;
+                for (long r = 0; r < rows; r++)
+                    for (int v : NeighbourRange(packed.bytes.data()))
+                        total += v;
+                sink = total; }));
+    }
+
+    // the sender side of send_discover() without the MPI call: the hop to a child is appended (with its key on a keyed
+    // graph, looked up in the neighbour table) and the latency stamp is written behind it
+    const int degree = 64, path_length = 64;
+    vector<int> neighbours(degree), keys(degree);
+    for (int i = 0; i < degree; i++)
+    {
+        neighbours[i] = i * 3;
+        keys[i] = (i * 7) % degree;
+    }
+    for (int keyed : {0, 1})
+    {
+        CompressedAdjacency adjacency;
+        adjacency.keyed = keyed;
+        adjacency.add_row(0, neighbours, &keys);
+        VertexIds ids;
+        NeighbourTable table;
+        table.assign(adjacency.bytes.data(), ids);
+        for (int stamp : {0, 1})
+        {
+            string name = "discover_pack/keyed=" + to_string(keyed) + "/stamp=" + to_string(stamp);
+            if (!selected(options, name))
+                continue;
+            const long ops = 100000;
+            vector<int> path(2 * path_length + PATH_SLACK_INTS, 1);
+            int length = table.entry_ints() * (path_length / 2);
+            results.push_back(measure(options, name, ops, [&]()
+                                      {
+                long total = 0;
+                for (long i = 0; i < ops; i++)
+                {
+                    int extended = table.append_hop(path.data(), length, neighbours[i % degree]);
+                    if (stamp)
+                        write_stamp(path.data() + extended);
+                    total += path[extended - 1];
+                }
+                sink = total; }));
+        }
+    }
+}
+
+/**
+ * Round trip of a message as the algorithm sends it (MPI_Issend) and receives it (MPI_Probe, MPI_Get_count, MPI_Recv)
+ * Rank 0 measures, rank 1 echoes
+ */
+void bench_ping_pong(const BenchOptions &options, vector<BenchResult> &results, int rank, int size)
+{
+    if (size < 2)
+        return;
+    const long ops = 2000;
+    for (int length : {0, 16, 1024})
+    {
+        string name = "mpi_ping_pong/ints=" + to_string(length);
+        int run = selected(options, name);
+        MPI_Bcast(&run, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        if (!run)
+            continue;
+        vector<int> buffer(length + 1);
+        auto round_trip = [&](int peer, bool first)
+        {
+            MPI_Request request;
+            MPI_Status status;
+            int count;
+            if (first)
+            {
+                MPI_Issend(buffer.data(), length, MPI_INT, peer, DISCOVER_TYPE, MPI_COMM_WORLD, &request);
+                MPI_Wait(&request, MPI_STATUS_IGNORE);
+            }
+            MPI_Probe(peer, DISCOVER_TYPE, MPI_COMM_WORLD, &status);
+            MPI_Get_count(&status, MPI_INT, &count);
+            MPI_Recv(buffer.data(), count, MPI_INT, peer, DISCOVER_TYPE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            if (!first)
+            {
+                MPI_Issend(buffer.data(), length, MPI_INT, peer, DISCOVER_TYPE, MPI_COMM_WORLD, &request);
+                MPI_Wait(&request, MPI_STATUS_IGNORE);
+            }
+        };
+        if (rank == 0)
+            results.push_back(measure(options, name, ops, [&]()
+                                      {
+                for (long i = 0; i < ops; i++)
+                    round_trip(1, true); }));
+        else if (rank == 1)
+            for (long i = 0; i < (options.warmup + options.reps) * ops; i++)
+                round_trip(0, false);
+    }
+}
+
+/**
+ * Parse the benchmark options
+ *
+ * @return false if an argument is not recognised
+ */
+bool parse_bench_options(int argc, char *argv[], BenchOptions *options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--reps" && i + 1 < argc)
+            options->reps = max(1, stoi(argv[++i]));
+        else if (arg == "--warmup" && i + 1 < argc)
+            options->warmup = max(0, stoi(argv[++i]));
+        else if (arg == "--filter" && i + 1 < argc)
+            options->filter = argv[++i];
+        else if (arg == "--tsv")
+            options->tsv = true;
+        else
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    BenchOptions options;
+    bool options_valid = parse_bench_options(argc, argv, &options);
+    int core = pin_to_core(environment_local_rank());
+
+    int rank, size;
+    MPI_Init(NULL, NULL);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    if (!options_valid)
+    {
+        if (rank == 0)
+            printf("usage: %s [--reps <n>] [--warmup <n>] [--filter <text>] [--tsv]\n", argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+    if (core == -1)
+        core = pin_to_core(node_local_rank(MPI_COMM_WORLD));
+
+    vector<BenchResult> results;
+    if (rank == 0 && !options.tsv)
+    {
+        printf("# %d timed repetitions after %d warmup, process pinned to core %d\n", options.reps, options.warmup, core);
+        printf("%-40s %12s %12s %12s\n", "benchmark", "median_ns", "min_ns", "max_ns");
+    }
+    if (rank == 0)
+    {
+        bench_path_order(options, results);
+        bench_path_copy(options, results);
+        bench_child_set(options, results);
+        bench_edge_parsing(options, results);
+        bench_pack(options, results);
+        for (const BenchResult &result : results)
+            print_result(options, result);
+        results.clear();
+    }
+    bench_ping_pong(options, results, rank, size);
+    for (const BenchResult &result : results)
+        print_result(options, result);
+
+    MPI_Finalize();
+    return 0;
+}
@@ -0,0 +1,309 @@
+/**
+* Predict the cost of a PDDFS run before launching it
+* The program reads a graph (the same input as the algorithm on STDIN, or a mapped CSR file with --csr) and prints cheap
+* statistics: size and density, the degree distribution in power-of-two buckets and a diameter estimate (the largest
+* eccentricity found by four double-sweep BFS passes, a lower bound). A vertex that cannot be reached from vertex 0 never
+* terminates, so disconnected graphs are flagged.
+*
+* Every --calibrate file is a result file of bench/run_benchmarks.sh, one file per configuration (build, solver options,
+* machine). The edges of its generated scenarios are counted exactly (Erdos-Renyi graphs are regenerated, tree_gen graphs
+* have n - 1 plus the extra edges), file scenarios are not used. Two models are fitted to the medians
+* of the repetitions by least squares:
+*   messages = a * edges + b * vertices
+*   wall_s   = c + d * messages
+* For every configuration the predicted messages, an upper bound of the payload bytes and the wall time of the graph are
+* printed. Only DISCOVER messages carry a payload, the path from the root with one int per hop (two on a keyed graph, the
+* key and the vertex), and a path holds at most every vertex. REJECT and TERMINATE messages carry none, and on a finished
+* run every vertex but the root has sent a TERMINATE. So the bound is
+*   bytes_max = (messages - (vertices - 1)) * sizeof(int) * ints per hop * vertices
+* which counts every other message as a DISCOVER with the longest path. Real runs send shorter paths and some REJECTs, so
+* they stay below it; with --latency every message carries a time stamp of two more ints on top. The predictions
+* extrapolate from the calibration scenarios and are only as good as their sizes are close to the graph.
+*
+* Output, one line per item:
+*   GRAPH vertices <n> edges <m> density <d> connected <0|1>
+*   DEGREE min <x> mean <x> max <x> stddev <x>
+*   DEGREES <lo>-<hi>:<count> ...
+*   DIAMETER <estimate>
+*   FIT <file> scenarios <k> messages_per_edge <a> messages_per_vertex <b> wall_s_base <c> wall_s_per_message <d>
+*   PREDICT <file> messages <x> bytes_max <x> wall_s <x>
+*
+* usage: pddfs_predict [--csr <mapped csr file>] [--calibrate <results.tsv>]... [< edges]
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "compressed_adjacency.h"
+#include "mapped_csr.h"
+
+using namespace std;
+
+/**
+ * Distances from a vertex by breadth first search, -1 for unreachable vertices
+ */
+vector<int> bfs_distances(const AdjacencyView &graph, int start)
+{
+    vector<int> distance(graph.n, -1), queue;
+    distance[start] = 0;
+    queue.push_back(start);
+    for (size_t head = 0; head < queue.size(); head++)
+        for (int w : graph.neighbours(queue[head]))
+            if (w < graph.n && distance[w] < 0)
+            {
+                distance[w] = distance[queue[head]] + 1;
+                queue.push_back(w);
+            }
+    return distance;
+}
+
+/**
+ * Estimate the diameter with double sweeps: BFS from a vertex, then BFS from the farthest vertex found
+ *
+ * @param graph The graph
+ * @param sweeps The amount of double sweeps, every sweep starts at the far end of the previous one
+ * @param connected Written with whether every vertex is reachable from vertex 0
+ * @return The largest eccentricity found, a lower bound of the diameter
+ */
+int estimate_diameter(const AdjacencyView &graph, int sweeps, bool *connected)
+{
+    int start = 0, best = 0;
+    *connected = true;
+    for (int s = 0; s < sweeps; s++)
+    {
+        vector<int> distance = bfs_distances(graph, start);
+        int far = (int)(max_element(distance.begin(), distance.end()) - distance.begin());
+        if (s == 0)
+            *connected = find(distance.begin(), distance.end(), -1) == distance.end();
+        distance = bfs_distances(graph, far);
+        int end = (int)(max_element(distance.begin(), distance.end()) - distance.begin());
+        best = max(best, distance[end]);
+        start = end;
+    }
+    return best;
+}
+
+/**
+ * Count the undirected edges erdos_renyi_gen generates, with the same random sequence
+ */
+long er_edges(int n, float p, unsigned long seed)
+{
+    srand(seed);
+    long edges = 0;
+    for (int i = 0; i < n; i++)
+        for (int j = i + 1; j < n; j++)
+            if ((double)rand() / RAND_MAX <= p)
+                edges++;
+    return edges;
+}
+
+double median(vector<double> values)
+{
+    sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+/**
+ * Cost model of one configuration
+ */
+struct CostModel
+{
+    int scenarios = 0;
+    double per_edge = 0, per_vertex = 0; // messages
+    double base = 0, per_message = 0;    // wall time in seconds
+};
+
+/**
+ * Fit the cost model to a benchmark result file
+ *
+ * @return false if the file cannot be read or holds no generated scenario with messages and wall time
+ */
+bool calibrate(const char *path, CostModel *model)
+{
+    ifstream in(path);
+    if (!in)
+        return false;
+    map<string, map<string, vector<double>>> results; // scenario, metric, repetitions
+    string line;
+    while (getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream fields(line);
+        string scenario, metric;
+        double value;
+        if (getline(fields, scenario, '\t') && getline(fields, metric, '\t') && fields >> value)
+            results[scenario][metric].push_back(value);
+    }
+
+    // per scenario: edges, vertices, messages, wall time
+    vector<double> m, n, messages, wall;
+    for (auto &scenario : results)
+    {
+        int vertices;
+        float p;
+        long extra;
+        unsigned long seed;
+        double edges;
+        if (scenario.second["messages"].empty() || scenario.second["wall_s"].empty())
+            continue;
+        if (sscanf(scenario.first.c_str(), "er/n=%d/p=%f/seed=%lu", &vertices, &p, &seed) == 3)
+            edges = (double)er_edges(vertices, p, seed);
+        else if (sscanf(scenario.first.c_str(), "tree/n=%d/extra=%ld/seed=%lu", &vertices, &extra, &seed) == 3)
+            edges = vertices - 1 + extra; // tree_gen adds exactly the extra edges a graph has room for
+        else
+            continue;
+        m.push_back(edges);
+        n.push_back(vertices);
+        messages.push_back(median(scenario.second["messages"]));
+        wall.push_back(median(scenario.second["wall_s"]));
+    }
+    model->scenarios = (int)m.size();
+    if (m.empty())
+        return false;
+
+    // messages: least squares through the origin in (edges, vertices), normal equations of the 2x2 system
+    double smm = 0, smn = 0, snn = 0, smy = 0, sny = 0;
+    for (size_t i = 0; i < m.size(); i++)
+    {
+        smm += m[i] * m[i];
+        smn += m[i] * n[i];
+        snn += n[i] * n[i];
+        smy += m[i] * messages[i];
+        sny += n[i] * messages[i];
+    }
+    double det = smm * snn - smn * smn;
+    if (m.size() >= 2 && fabs(det) > 1e-9 * smm * snn)
+    {
+        model->per_edge = (smy * snn - sny * smn) / det;
+        model->per_vertex = (sny * smm - smy * smn) / det;
+    }
+    if (model->per_edge < 0 || model->per_vertex < 0 || (model->per_edge == 0 && model->per_vertex == 0)) // too few or degenerate scenarios: messages per edge only
+    {
+        model->per_edge = smy / smm;
+        model->per_vertex = 0;
+    }
+
+    // wall time: ordinary least squares on the measured messages
+    double mean_x = 0, mean_y = 0, sxx = 0, sxy = 0;
+    for (size_t i = 0; i < m.size(); i++)
+    {
+        mean_x += messages[i] / m.size();
+        mean_y += wall[i] / m.size();
+    }
+    for (size_t i = 0; i < m.size(); i++)
+    {
+        sxx += (messages[i] - mean_x) * (messages[i] - mean_x);
+        sxy += (messages[i] - mean_x) * (wall[i] - mean_y);
+    }
+    model->per_message = sxx > 0 ? sxy / sxx : (mean_x > 0 ? mean_y / mean_x : 0);
+    model->base = sxx > 0 ? mean_y - model->per_message * mean_x : 0;
+    if (model->base < 0 || model->per_message < 0) // noisy small scenarios: proportional to messages
+    {
+        model->per_message = mean_x > 0 ? mean_y / mean_x : 0;
+        model->base = 0;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *csr_path = NULL;
+    vector<const char *> calibrations;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--csr" && i + 1 < argc)
+            csr_path = argv[++i];
+        else if (arg == "--calibrate" && i + 1 < argc)
+            calibrations.push_back(argv[++i]);
+        else
+        {
+            cerr << "usage: " << argv[0] << " [--csr <mapped csr file>] [--calibrate <results.tsv>]... [< edges]" << endl;
+            return 1;
+        }
+    }
+
+    CompressedAdjacency adjacency;
+    MappedCsr mapped;
+    AdjacencyView graph;
+    if (csr_path != NULL)
+    {
+        if (!mapped.open(csr_path) || !mapped.valid_rows()) // every row is decoded in this process
+        {
+            cerr << "could not map " << csr_path << endl;
+            return 1;
+        }
+        graph = mapped.view();
+    }
+    else
+    {
+        read_edge_list(cin, adjacency);
+        graph = adjacency.view();
+    }
+    if (graph.n == 0)
+    {
+        cerr << "empty graph" << endl;
+        return 1;
+    }
+
+    long entries = 0;
+    uint32_t min_degree = UINT32_MAX, max_degree = 0;
+    double square_sum = 0;
+    map<int, long> buckets; // bucket b holds degrees 2^(b-1) .. 2^b - 1, bucket 0 degree 0
+    for (int v = 0; v < graph.n; v++)
+    {
+        uint32_t d = graph.degree(v);
+        entries += d;
+        min_degree = min(min_degree, d);
+        max_degree = max(max_degree, d);
+        square_sum += (double)d * d;
+        int b = 0;
+        while (b < 32 && (1u << b) <= d)
+            b++;
+        buckets[b]++;
+    }
+    long edges = entries / 2; // every edge is stored in both directions
+    double mean = (double)entries / graph.n;
+    double density = graph.n > 1 ? (double)entries / ((double)graph.n * (graph.n - 1)) : 0;
+    bool connected;
+    int diameter = estimate_diameter(graph, 4, &connected);
+
+    printf("GRAPH vertices %d edges %ld density %.6g connected %d\n", graph.n, edges, density, connected);
+    printf("DEGREE min %u mean %.3f max %u stddev %.3f\n", min_degree, mean, max_degree, sqrt(max(0.0, square_sum / graph.n - mean * mean)));
+    printf("DEGREES");
+    for (auto &bucket : buckets)
+    {
+        long lo = bucket.first == 0 ? 0 : 1L << (bucket.first - 1), hi = bucket.first == 0 ? 0 : (1L << bucket.first) - 1;
+        printf(" %ld-%ld:%ld", lo, hi, bucket.second);
+    }
+    printf("\nDIAMETER %d\n", diameter);
+    if (!connected)
+        printf("WARNING not every vertex is reachable from vertex 0, the run will not terminate\n");
+
+    for (const char *path : calibrations)
+    {
+        CostModel model;
+        if (!calibrate(path, &model))
+        {
+            cerr << "no usable generated scenarios in " << path << endl;
+            continue;
+        }
+        double messages = model.per_edge * edges + model.per_vertex * graph.n;
+        double payload_messages = max(0.0, messages - (graph.n - 1)); // all but the TERMINATEs
+        double bytes_max = payload_messages * sizeof(int) * (graph.keyed() ? 2 : 1) * graph.n;
+        printf("FIT %s scenarios %d messages_per_edge %.4g messages_per_vertex %.4g wall_s_base %.4g wall_s_per_message %.4g\n",
+               path, model.scenarios, model.per_edge, model.per_vertex, model.base, model.per_message);
+        printf("PREDICT %s messages %.0f bytes_max %.0f wall_s %.3f\n", path, messages, bytes_max, model.base + model.per_message * messages);
+    }
+    return 0;
+}
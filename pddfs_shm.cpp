@@ -0,0 +1,185 @@
+/**
+ * Musaev's PDDFS algorithm on one machine without MPI
+ * The program is its own launcher: it reads the graph, creates the shared memory segment of the transport
+ * (shm_transport.h) and forks one process per vertex, exactly like mpirun -np <vertices> pddfs would start them. Every
+ * process runs the protocol loop of vertex_protocol.h, the same as pddfs, with the transport's send, probe and receive in
+ * place of the MPI calls. The processes stay isolated, they only share the message rings.
+ *
+ * Input is the same as for the pddfs program: edges on STDIN, or a mapped CSR file with --csr.
+ * Output is the same DONE line per vertex, followed by a summary from the launcher:
+ *   SHM processes <n> finished <f> seconds <s>
+ * With --timeout <seconds> the processes still running after that time are killed and counted in a TIMEOUT line, the
+ * protocol can hang on some message orders. The exit status is 1 when not every process finished.
+ *
+ * usage: pddfs_shm [-np <processes>] [--csr <mapped csr file>] [--timeout <seconds>] [< edges]
+ */
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "compressed_adjacency.h"
+#include "mapped_csr.h"
+#include "shm_transport.h"
+#include "vertex_protocol.h"
+
+/**
+ * The shared memory transport of the protocol (vertex_protocol.h), process r hosts vertex r
+ */
+class ShmVertexTransport : public BasicTransport
+{
+public:
+    typedef ShmStatus Status;
+
+    explicit ShmVertexTransport(ShmTransport &t) : t(t) {}
+
+    void wait(Status *status) { t.probe(SHM_ANY_SOURCE, SHM_ANY_TAG, status); }
+
+    int receive_path(const Status &status, large_vector<int> &path)
+    {
+        fit_path(path, status.count);
+        t.recv(path.data(), status);
+        return status.count;
+    }
+
+    void receive_control(const Status &status) { t.recv_control(status); }
+
+    void send_discover(const NeighbourTable &neighbours, int dest, int path[], int path_length)
+    {
+        t.send(dest, DISCOVER_TYPE, path, neighbours.append_hop(path, path_length, dest));
+    }
+
+    void send_reject(const NeighbourTable &, int dest) { t.send(dest, REJECT_TYPE, NULL, 0); }
+
+    void send_terminate(const NeighbourTable &, int dest) { t.send(dest, TERMINATE_TYPE, NULL, 0); }
+
+private:
+    ShmTransport &t;
+};
+
+int main(int argc, char *argv[])
+{
+    int processes = 0;
+    const char *csr_path = NULL;
+    double timeout = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-np" && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            processes = atoi(argv[++i]);
+        else if (arg == "--csr" && i + 1 < argc)
+            csr_path = argv[++i];
+        else if (arg == "--timeout" && i + 1 < argc && atof(argv[i + 1]) > 0)
+            timeout = atof(argv[++i]);
+        else
+        {
+            std::cerr << "usage: " << argv[0] << " [-np <processes>] [--csr <mapped csr file>] [--timeout <seconds>] [< edges]" << std::endl;
+            return 1;
+        }
+    }
+
+    CompressedAdjacency adjacency;
+    MappedCsr mapped;
+    AdjacencyView graph;
+    if (csr_path != NULL)
+    {
+        if (!mapped.open(csr_path) || !mapped.valid_rows()) // every row is decoded in this process
+        {
+            std::cerr << "could not map " << csr_path << std::endl;
+            return 1;
+        }
+        graph = mapped.view();
+    }
+    else
+    {
+        read_edge_list(std::cin, adjacency, processes);
+        graph = adjacency.view();
+    }
+    if (processes == 0)
+        processes = graph.n;
+    if (processes < graph.n || processes == 0)
+    {
+        std::cerr << "the graph has " << graph.n << " vertices, one process per vertex is needed" << std::endl;
+        return 1;
+    }
+
+    int max_path = path_entry_ints(graph.keyed()) * processes;
+    size_t ring_ints = shm_ring_ints(max_path + 1);
+    void *segment = create_shm_segment(processes, ring_ints);
+    if (segment == NULL)
+    {
+        std::cerr << "could not create the shared memory segment" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    fflush(stdout); // nothing buffered may be duplicated into the children
+    std::vector<pid_t> children(processes, -1);
+    for (int r = 0; r < processes; r++)
+    {
+        children[r] = fork();
+        if (children[r] < 0)
+        {
+            std::cerr << "could not start process " << r << std::endl;
+            for (int c = 0; c < r; c++)
+                kill(children[c], SIGKILL);
+            return 1;
+        }
+        if (children[r] == 0)
+        {
+            static const uint8_t empty_row[1] = {0};
+            const uint8_t *row = r < graph.n ? graph.bytes + graph.offsets[r] : empty_row;
+            ShmTransport transport(segment, r, processes, ring_ints);
+            ShmVertexTransport vertex_transport(transport);
+            VertexIds ids;
+            VertexState state(r, max_path, ids);
+            int msgct = run_vertex(vertex_transport, state, row);
+            transport.close();
+            std::string children_list = "[";
+            for (int child : state.neighbours.collect(NEIGHBOUR_CHILD))
+                children_list += std::to_string(child) + ", ";
+            std::string out = "[" + std::to_string(state.id) + "]:\t DONE - Children: " + children_list + "]\t\t" + std::to_string(msgct) + "\n";
+            if (write(STDOUT_FILENO, out.data(), out.size()) < 0) // one write per line, lines of different processes do not mix
+                _exit(1);
+            _exit(0);
+        }
+    }
+
+    int finished = 0, running = processes;
+    while (running > 0)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, timeout > 0 ? WNOHANG : 0);
+        if (pid > 0)
+        {
+            running--;
+            finished += WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            for (pid_t &child : children)
+                if (child == pid)
+                    child = -1;
+            continue;
+        }
+        if (pid < 0)
+            break;
+        if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > timeout)
+        {
+            for (pid_t child : children)
+                if (child > 0)
+                {
+                    kill(child, SIGKILL);
+                    waitpid(child, NULL, 0);
+                }
+            printf("TIMEOUT %d processes did not finish\n", running);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    printf("SHM processes %d finished %d seconds %.6f\n", processes, finished,
+           std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return finished == processes ? 0 : 1;
+}
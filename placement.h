@@ -0,0 +1,116 @@
+/**
+ * Process placement for the PDDFS algorithm
+ * With --pin every process is bound to one core of the cores it is allowed to run on, chosen by its rank on the machine.
+ * Linux allocates memory on the NUMA node of the core that first touches it, so pinning happens before the graph is loaded
+ * and the vertex state is created: the adjacency row, the path buffers and the neighbour table all end up on the local node.
+ * When the launcher exports the node-local rank (Open MPI, MPICH/Hydra, Slurm), pinning is done before MPI_Init as well,
+ * so the buffers MPI allocates for its shared-memory mailboxes are placed on the node of the owning process too.
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <cstdlib>
+#include <mpi.h>
+#include <sched.h>
+#include <unistd.h>
+#include <map>
+#include <utility>
+#include <vector>
+#include <sys/syscall.h>
+
+/**
+ * @return The node-local rank exported by the launcher, -1 if there is none
+ */
+inline int environment_local_rank()
+{
+    const char *names[] = {"OMPI_COMM_WORLD_LOCAL_RANK", "MPI_LOCALRANKID", "SLURM_LOCALID", "PMI_LOCAL_RANK"};
+    for (const char *name : names)
+    {
+        const char *value = getenv(name);
+        if (value != NULL)
+            return atoi(value);
+    }
+    return -1;
+}
+
+/**
+ * @return The rank of the current process among the processes that share its machine
+ */
+inline int node_local_rank(MPI_Comm comm)
+{
+    MPI_Comm node;
+    int rank;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node);
+    MPI_Comm_rank(node, &rank);
+    MPI_Comm_free(&node);
+    return rank;
+}
+
+/**
+ * @return The NUMA node the current process runs on, -1 if unknown
+ */
+inline int current_numa_node()
+{
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+        return -1;
+    return (int)node;
+}
+
+/**
+ * Find the machine of every rank, collective
+ *
+ * @param comm The communicator of the ranks
+ * @param root The process that gets the table
+ * @param numa Count every NUMA node of a machine as a machine of its own, by the node the process currently runs on
+ * @return On the root: machine[r] for every rank r, machines numbered in the order of their first rank. Empty elsewhere
+ */
+inline std::vector<int> machine_of_ranks(MPI_Comm comm, int root, bool numa = false)
+{
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Comm node;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+    int leader = rank;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, node);
+    MPI_Comm_free(&node);
+    int place[2] = {leader, numa ? current_numa_node() : 0};
+    std::vector<int> places(rank == root ? 2 * size : 0), machine(rank == root ? size : 0);
+    MPI_Gather(place, 2, MPI_INT, places.data(), 2, MPI_INT, root, comm);
+    std::map<std::pair<int, int>, int> machine_of_place;
+    for (int r = 0; r < (int)machine.size(); r++)
+        machine[r] = machine_of_place.insert(std::make_pair(std::make_pair(places[2 * r], places[2 * r + 1]), (int)machine_of_place.size())).first->second;
+    return machine;
+}
+
+/**
+ * Bind the current process to a single core
+ * Cores are taken in order from the affinity mask the process was started with, wrapping around when oversubscribed
+ *
+ * @param local_rank The node-local rank of the current process
+ * @return The core the process is bound to, -1 on failure
+ */
+inline int pin_to_core(int local_rank)
+{
+    cpu_set_t allowed;
+    if (local_rank < 0 || sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return -1;
+    int count = CPU_COUNT(&allowed);
+    if (count == 0)
+        return -1;
+    int target = local_rank % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &allowed) || target-- > 0)
+            continue;
+        cpu_set_t single;
+        CPU_ZERO(&single);
+        CPU_SET(cpu, &single);
+        return sched_setaffinity(0, sizeof(single), &single) == 0 ? cpu : -1;
+    }
+    return -1;
+}
+
+#endif
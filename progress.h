@@ -0,0 +1,123 @@
+/**
+ * Live progress of a PDDFS run
+ * With --progress <seconds> the processes sum their counters (mounted, terminated, messages handled, parent changes)
+ * in rounds of MPI_Iallreduce on a private communicator, and the root prints one PROGRESS line per round.
+ * A round is only started and tested between messages, so the protocol loop never blocks on it: while waiting for a message
+ * the loop polls with MPI_Iprobe instead of blocking in MPI_Probe. A running process joins a new round once the interval has
+ * passed since the previous one, a terminated process keeps joining rounds right away until a round counts every process
+ * as terminated, so all processes leave after the same round.
+ */
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <mpi.h>
+#include <cstdio>
+
+enum ProgressValue
+{
+    PROGRESS_MOUNTED,
+    PROGRESS_TERMINATED,
+    PROGRESS_MESSAGES,
+    PROGRESS_PARENT_CHANGES,
+    PROGRESS_VALUES
+};
+
+class ProgressReporter
+{
+public:
+    ProgressReporter() : comm(MPI_COMM_NULL), request(MPI_REQUEST_NULL), finished(false) {}
+    ProgressReporter(const ProgressReporter &) = delete;
+    ProgressReporter &operator=(const ProgressReporter &) = delete;
+
+    /**
+     * Start reporting, collective
+     *
+     * @param seconds The time between rounds
+     * @param parent The communicator of all processes, duplicated so rounds cannot match protocol traffic
+     */
+    void start(double seconds, MPI_Comm parent)
+    {
+        interval = seconds;
+        MPI_Comm_dup(parent, &comm);
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        start_time = last_round = last_print = MPI_Wtime();
+        for (int i = 0; i < PROGRESS_VALUES; i++)
+            previous[i] = 0;
+    }
+
+    /**
+     * Free the communicator, collective, only after done() returned true
+     */
+    void stop()
+    {
+        if (comm != MPI_COMM_NULL)
+            MPI_Comm_free(&comm);
+    }
+
+    bool enabled() const { return comm != MPI_COMM_NULL; }
+
+    /**
+     * @return true once a round counted every process as terminated
+     */
+    bool done() const { return finished; }
+
+    /**
+     * Test the running round and start a new one when it is due, never blocks
+     *
+     * @param values The counters of the current process, totals since the start of the run
+     */
+    void poll(const long values[PROGRESS_VALUES])
+    {
+        if (finished)
+            return;
+        if (request != MPI_REQUEST_NULL)
+        {
+            int complete;
+            MPI_Test(&request, &complete, MPI_STATUS_IGNORE);
+            if (!complete)
+                return;
+            last_round = MPI_Wtime();
+            finished = sums[PROGRESS_TERMINATED] == size;
+            if (rank == 0 && (finished || last_round - last_print >= interval))
+                print();
+            if (finished)
+                return;
+        }
+        if (!values[PROGRESS_TERMINATED] && MPI_Wtime() - last_round < interval)
+            return;
+        for (int i = 0; i < PROGRESS_VALUES; i++)
+            contribution[i] = values[i];
+        MPI_Iallreduce(contribution, sums, PROGRESS_VALUES, MPI_LONG, MPI_SUM, comm, &request);
+    }
+
+private:
+    /**
+     * Print the result of the last round, messages and parent changes as rates since the previous line
+     */
+    void print()
+    {
+        double elapsed = last_round - last_print;
+        double rate = elapsed > 0 ? 1 / elapsed : 0;
+        printf("PROGRESS t=%.1fs mounted %ld/%d terminated %ld/%d messages %ld (%.0f/s) parent_changes %.0f/s\n",
+               last_round - start_time, sums[PROGRESS_MOUNTED], size, sums[PROGRESS_TERMINATED], size,
+               sums[PROGRESS_MESSAGES] - previous[PROGRESS_MESSAGES], (sums[PROGRESS_MESSAGES] - previous[PROGRESS_MESSAGES]) * rate,
+               (sums[PROGRESS_PARENT_CHANGES] - previous[PROGRESS_PARENT_CHANGES]) * rate);
+        fflush(stdout);
+        for (int i = 0; i < PROGRESS_VALUES; i++)
+            previous[i] = sums[i];
+        last_print = last_round;
+    }
+
+    MPI_Comm comm;
+    MPI_Request request;
+    int rank, size;
+    bool finished;
+    double interval, start_time, last_round, last_print;
+    long contribution[PROGRESS_VALUES]; // send buffer of the running round
+    long sums[PROGRESS_VALUES];
+    long previous[PROGRESS_VALUES]; // sums at the last printed line
+};
+
+#endif
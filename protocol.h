@@ -0,0 +1,157 @@
+/**
+ * MPI primitives of the PDDFS protocol, the message types and the path order are in protocol_core.h
+ * Shared by the algorithm and the microbenchmarks (pddfs_microbench.cpp), so both measure the same code.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <vector>
+#include "comm_matrix.h"
+#include "latency.h"
+#include "protocol_core.h"
+#include "vertex_state.h"
+
+static_assert(PATH_SLACK_INTS >= 2 + MESSAGE_STAMP_INTS, "a path buffer has room for a keyed hop and the stamp");
+
+/**
+ * Synchronous sends that have not been matched by their receiver yet
+ * The protocol never waits for its sends, completed requests are released in batches whenever the list has doubled.
+ * A control stamp sent with a request (latency.h) is returned for reuse when the request completes.
+ */
+class PendingSends
+{
+public:
+    PendingSends() : limit(64) {}
+
+    /**
+     * @param request The send
+     * @param stamp The control stamp the send reads from, NULL if it has none
+     */
+    void add(MPI_Request request, int *stamp = NULL)
+    {
+        requests.push_back(request);
+        stamps.push_back(stamp);
+        if (requests.size() >= limit)
+        {
+            collect();
+            limit = std::max<size_t>(64, 2 * requests.size());
+        }
+    }
+
+    /**
+     * @return The amount of sends that have not been matched yet
+     */
+    size_t count()
+    {
+        collect();
+        return requests.size();
+    }
+
+private:
+    void collect()
+    {
+        if (requests.empty())
+            return;
+        int completed;
+        std::vector<int> indices(requests.size());
+        MPI_Testsome((int)requests.size(), requests.data(), &completed, indices.data(), MPI_STATUSES_IGNORE);
+        size_t kept = 0;
+        for (size_t i = 0; i < requests.size(); i++)
+        {
+            if (requests[i] == MPI_REQUEST_NULL)
+            {
+                if (stamps[i] != NULL)
+                    release_stamp(stamps[i]);
+                continue;
+            }
+            requests[kept] = requests[i];
+            stamps[kept++] = stamps[i];
+        }
+        requests.resize(kept);
+        stamps.resize(kept);
+    }
+
+    std::vector<MPI_Request> requests;
+    std::vector<int *> stamps;
+    size_t limit;
+};
+
+inline PendingSends &pending_sends()
+{
+    static PendingSends sends;
+    return sends;
+}
+
+/**
+ * Send DISCOVER message to a single destination
+ * 
+ * @param neighbours The neighbour table, provides the ordering key of the hop to dest
+ * @param dest The vertex to send DISCOVER to, appended to the path
+ * @param dest_rank The rank hosting dest
+ * @param path The path vector at the current node, needs room for one more entry and the latency stamp
+ * @param path_length The size of the path vector
+ * @param comm The communicator to write on
+ * @return DISCOVER message with the path vector (with destination ID appended) written to the destination channel
+ */
+inline void send_discover(const NeighbourTable &neighbours, int dest, int dest_rank, int path[], int path_length, MPI_Comm comm)
+{
+    MPI_Request request;
+    int length = neighbours.append_hop(path, path_length, dest);
+    if (message_latency().enabled)
+        write_stamp(path + length);
+    MPI_Issend(path, length + stamp_ints(), MPI_INT, dest_rank, DISCOVER_TYPE, comm, &request);
+    count_send(dest_rank, DISCOVER_TYPE, length + stamp_ints());
+    pending_sends().add(request);
+}
+
+/**
+ * Send DISCOVER message to all children
+ * 
+ * @param neighbours The neighbour table, DISCOVER is sent to every neighbour that is a child, in the preferred order
+ * @param path The path vector at the current node
+ * @param path_length The size of the path vector
+ * @param comm The communicator to write on
+ * @return DISCOVER messages with the path vector (with destination ID appended) written to each destination channel
+ */
+inline void send_discover(const NeighbourTable &neighbours, int path[], int path_length, MPI_Comm comm)
+{
+    neighbours.for_each_child([&](int dest, int dest_rank)
+                              { send_discover(neighbours, dest, dest_rank, path, path_length, comm); });
+}
+
+/**
+ * Send REJECT message to destination
+ * 
+ * @param dest The rank to send REJECT to
+ * @param comm The communicator to write on
+ * @return REJECT message written to the destination channel
+ */
+inline void send_reject(int dest, MPI_Comm comm)
+{
+    MPI_Request request;
+    int *stamp = message_latency().enabled ? control_stamp() : NULL;
+    MPI_Issend(stamp, stamp_ints(), MPI_INT, dest, REJECT_TYPE, comm, &request);
+    count_send(dest, REJECT_TYPE, stamp_ints());
+    pending_sends().add(request, stamp);
+}
+
+/**
+ * Send TERMINATE message to destination
+ * 
+ * @param parent The rank to send TERMINATE to
+ * @param comm The communicator to write on
+ * @return TERMINATE message written to the destination channel
+ */
+inline void send_terminate(int parent, MPI_Comm comm)
+{
+    MPI_Request request;
+    int *stamp = message_latency().enabled ? control_stamp() : NULL;
+    MPI_Issend(stamp, stamp_ints(), MPI_INT, parent, TERMINATE_TYPE, comm, &request);
+    count_send(parent, TERMINATE_TYPE, stamp_ints());
+    pending_sends().add(request, stamp);
+}
+
+#endif
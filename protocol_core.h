@@ -0,0 +1,63 @@
+/**
+ * Message types, path order and profiled sections of the PDDFS protocol, without any transport
+ * Used by every transport: MPI (protocol.h), the coroutine actors (pddfs_actors.cpp) and shared memory (pddfs_shm.cpp),
+ * which all run the handlers of vertex_protocol.h.
+ */
+
+#ifndef PROTOCOL_CORE_H
+#define PROTOCOL_CORE_H
+
+#include <algorithm>
+
+#define DISCOVER_TYPE 1
+#define REJECT_TYPE 2
+#define TERMINATE_TYPE 3
+
+/**
+ * Sections of the protocol loop, timed with --profile-handlers (handler_profile.h)
+ */
+enum ProfileSection
+{
+    PROFILE_PROBE,
+    PROFILE_DISCOVER,
+    PROFILE_REJECT,
+    PROFILE_TERMINATE,
+    PROFILE_PATH_ORDER,
+    PROFILE_CHILD_SET,
+    PROFILE_SECTIONS
+};
+
+/**
+ * Paths of a keyed graph hold a (key, vertex) pair per hop, the key of the edge the hop was taken over, so comparing
+ * paths element by element prefers the lower key and breaks ties on the vertex ID. Unkeyed paths hold the vertices only.
+ *
+ * @param keyed The graph carries ordering keys
+ * @return The ints of one path entry
+ */
+inline int path_entry_ints(bool keyed)
+{
+    return keyed ? 2 : 1;
+}
+
+/**
+ * Calculate path order, which path is 'more depth-first'
+ * 
+ * @param path_length_1 The length of the first path
+ * @param path1 The first path vector
+ * @param path_length2 The length of the second path
+ * @param path2 The second path vector
+ * @return -1 for path1 >_{df} path2, 1 for path1 <_{df} path2, 0 for path1 \subset_{df} path2 
+ */
+inline int path_order(int path_length_1, int path1[], int path_length_2, int path2[])
+{
+    for (int i = 0; i < std::min(path_length_1, path_length_2); i++)
+    {
+        if (path1[i] < path2[i])
+            return -1;
+        else if (path1[i] > path2[i])
+            return 1;
+    }
+    return 0;
+}
+
+#endif
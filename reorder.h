@@ -0,0 +1,132 @@
+/**
+ * Locality-improving vertex orderings for the PDDFS algorithm
+ * Every vertex is hosted by one process, and processes with consecutive ranks share a machine. Placing vertices that
+ * are close in the graph on consecutive ranks turns most DISCOVER/REJECT/TERMINATE messages into shared-memory messages
+ * and keeps the mapped CSR rows that one machine reads close together.
+ *
+ * The algorithm itself is defined on the original vertex IDs (path order, tie-breaks, output), so a reordering only
+ * decides which rank hosts which vertex. VertexIds translates between the two and is the only place that knows about it.
+ */
+
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "compressed_adjacency.h"
+
+enum VertexOrder
+{
+    ORDER_NONE,
+    ORDER_BFS,
+    ORDER_RCM
+};
+
+/**
+ * Translation between ranks and original vertex IDs, both tables are empty for the identity
+ */
+struct VertexIds
+{
+    std::vector<int> original; // original[rank] is the vertex hosted by rank
+    std::vector<int> rank;     // rank[vertex] is the rank hosting vertex
+
+    int original_id(int r) const { return original.empty() ? r : original[r]; }
+    int rank_of(int v) const { return rank.empty() ? v : rank[v]; }
+
+    /**
+     * Set the tables from a hosting order
+     *
+     * @param order order[r] is the original vertex placed on rank r
+     */
+    void assign(const std::vector<int> &order)
+    {
+        original = order;
+        rank.assign(order.size(), 0);
+        for (size_t r = 0; r < order.size(); r++)
+            rank[order[r]] = (int)r;
+    }
+};
+
+/**
+ * Breadth-first (Cuthill-McKee style) order of all vertices
+ * Every component is started from its first unvisited vertex (vertex 0 first, so the root stays near rank 0),
+ * or from its lowest degree vertex when by_degree is set. With by_degree, neighbours are also visited by increasing degree.
+ *
+ * @param graph The adjacency to order
+ * @param by_degree Use the Cuthill-McKee degree rules
+ * @return order[i] is the vertex at position i
+ */
+inline std::vector<int> breadth_first_order(const AdjacencyView &graph, bool by_degree)
+{
+    std::vector<int> order;
+    std::vector<char> visited(graph.n, 0);
+    std::vector<int> starts(graph.n);
+    std::vector<int> next;
+    order.reserve(graph.n);
+    for (int v = 0; v < graph.n; v++)
+        starts[v] = v;
+    if (by_degree)
+        std::stable_sort(starts.begin(), starts.end(), [&](int a, int b)
+                         { return graph.degree(a) < graph.degree(b); });
+
+    for (int start : starts)
+    {
+        if (visited[start])
+            continue;
+        visited[start] = 1;
+        size_t head = order.size();
+        order.push_back(start);
+        while (head < order.size())
+        {
+            int v = order[head++];
+            next.clear();
+            for (int w : graph.neighbours(v))
+                if (w < graph.n && !visited[w])
+                {
+                    visited[w] = 1;
+                    next.push_back(w);
+                }
+            if (by_degree)
+                std::stable_sort(next.begin(), next.end(), [&](int a, int b)
+                                 { return graph.degree(a) < graph.degree(b); });
+            order.insert(order.end(), next.begin(), next.end());
+        }
+    }
+    return order;
+}
+
+/**
+ * Compute a hosting order
+ *
+ * @param graph The adjacency to order
+ * @param kind The ordering to use, ORDER_RCM is reverse Cuthill-McKee
+ * @return order[r] is the original vertex that rank r hosts, empty for ORDER_NONE
+ */
+inline std::vector<int> vertex_order(const AdjacencyView &graph, VertexOrder kind)
+{
+    if (kind == ORDER_NONE)
+        return std::vector<int>();
+    std::vector<int> order = breadth_first_order(graph, kind == ORDER_RCM);
+    if (kind == ORDER_RCM)
+        std::reverse(order.begin(), order.end());
+    return order;
+}
+
+/**
+ * @return The ordering named by s ("none", "bfs" or "rcm"), false if the name is unknown
+ */
+inline bool parse_vertex_order(const std::string &s, VertexOrder *kind)
+{
+    if (s == "none")
+        *kind = ORDER_NONE;
+    else if (s == "bfs")
+        *kind = ORDER_BFS;
+    else if (s == "rcm")
+        *kind = ORDER_RCM;
+    else
+        return false;
+    return true;
+}
+
+#endif
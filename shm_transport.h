@@ -0,0 +1,308 @@
+/**
+ * Message transport between processes of one machine over POSIX shared memory, without MPI
+ * Provides the primitives the protocol loop uses from MPI: a send that never blocks the sender, and a blocking or polling
+ * probe for a source and tag followed by a receive of the probed message.
+ *
+ * Every process owns one ring buffer in a shared segment, and all other processes write into it. Writers serialise on a
+ * spinlock in the ring and append one record (source, tag, count, payload ints). The owner is the only reader. It moves
+ * records into a private queue, so probes for a specific source and tag can look past other messages like MPI_Probe.
+ * A reader with nothing to do sleeps on a futex in its ring, and writers wake it. A send into a ring without room for the
+ * record stays in a private outbox of the sender and is retried on every later call, so two processes that fill each
+ * other's rings never deadlock. A process marks its ring closed when it leaves, later sends to it are dropped, as a
+ * message to a finished MPI process is never received.
+ *
+ * The segment is created by the spawner (pddfs_shm.cpp) before it forks the processes, see create_shm_segment().
+ */
+
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define SHM_ANY_SOURCE -1
+#define SHM_ANY_TAG -1
+#define SHM_HEADER_INTS 3      // source, tag, count in front of every record
+#define SHM_MIN_RING_INTS 4096 // ring size for small graphs, 16 KB
+#define SHM_CACHE_LINE 64
+
+/**
+ * Control block in front of the data of every ring, writers and the reader work on separate cache lines
+ */
+struct ShmRingControl
+{
+    alignas(SHM_CACHE_LINE) std::atomic<uint32_t> lock; // writers
+    std::atomic<uint64_t> tail;                          // ints written, advanced by writers
+    alignas(SHM_CACHE_LINE) std::atomic<uint64_t> head;  // ints read, advanced by the reader
+    std::atomic<uint32_t> signal;                        // futex word, bumped after every write
+    std::atomic<uint32_t> sleeping;                      // the reader waits on signal
+    std::atomic<uint32_t> closed;                        // the reader has left, writes are dropped
+};
+
+/**
+ * What a probe found
+ */
+struct ShmStatus
+{
+    int source;
+    int tag;
+    int count; // ints of payload
+};
+
+inline long futex(std::atomic<uint32_t> *word, int op, uint32_t value, const struct timespec *timeout)
+{
+    return syscall(SYS_futex, (uint32_t *)word, op, value, timeout, NULL, 0); // not FUTEX_PRIVATE, the word is shared between processes
+}
+
+/**
+ * @param max_ints The largest payload of a message
+ * @return The ints of one ring, a power of two that holds at least four of the largest records
+ */
+inline size_t shm_ring_ints(int max_ints)
+{
+    size_t ints = SHM_MIN_RING_INTS;
+    while (ints < 4 * (size_t)(max_ints + SHM_HEADER_INTS))
+        ints *= 2;
+    return ints;
+}
+
+inline size_t shm_ring_stride(size_t ring_ints)
+{
+    size_t bytes = sizeof(ShmRingControl) + ring_ints * sizeof(uint32_t);
+    return (bytes + SHM_CACHE_LINE - 1) & ~(size_t)(SHM_CACHE_LINE - 1);
+}
+
+/**
+ * Create and map the shared segment of size rings, the name is unlinked right away so nothing is left behind
+ * The mapping is inherited by processes forked afterwards.
+ *
+ * @return The segment, NULL on failure
+ */
+inline void *create_shm_segment(int size, size_t ring_ints)
+{
+    std::string name = "/pddfs-" + std::to_string(getpid());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return NULL;
+    shm_unlink(name.c_str());
+    size_t bytes = size * shm_ring_stride(ring_ints);
+    void *segment = ftruncate(fd, bytes) == 0 ? mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    return segment == MAP_FAILED ? NULL : segment; // a new shared memory object is zero-filled: every ring starts empty and unlocked
+}
+
+class ShmTransport
+{
+public:
+    /**
+     * @param segment The mapped segment of create_shm_segment()
+     * @param rank The process the transport belongs to, the owner of ring rank
+     * @param size The amount of processes
+     * @param ring_ints The ints of one ring
+     */
+    ShmTransport(void *segment, int rank, int size, size_t ring_ints) : base((uint8_t *)segment), rank_(rank), size_(size),
+                                                                          ring_ints(ring_ints), stride(shm_ring_stride(ring_ints)) {}
+
+    int rank() const { return rank_; }
+    int size() const { return size_; }
+
+    /**
+     * Send a message, returns at once, a full destination ring keeps the message in the outbox
+     */
+    void send(int dest, int tag, const int *data, int count)
+    {
+        flush_outbox();
+        if (outbox.empty() && write(dest, tag, data, count))
+            return;
+        outbox.push_back(Pending{dest, tag, std::vector<int>(data, data + count)}); // after earlier messages, the order per destination is kept
+    }
+
+    /**
+     * Wait for a message from source with tag, SHM_ANY_SOURCE and SHM_ANY_TAG match any
+     */
+    void probe(int source, int tag, ShmStatus *status)
+    {
+        while (!iprobe(source, tag, status))
+            wait();
+    }
+
+    /**
+     * @return true if a matching message is waiting, its status is written
+     */
+    bool iprobe(int source, int tag, ShmStatus *status)
+    {
+        flush_outbox();
+        drain();
+        for (const Message &m : inbox)
+            if ((source == SHM_ANY_SOURCE || m.source == source) && (tag == SHM_ANY_TAG || m.tag == tag))
+            {
+                *status = ShmStatus{m.source, m.tag, (int)m.data.size()};
+                return true;
+            }
+        return false;
+    }
+
+    /**
+     * Receive the first message from the source and with the tag of a probed status
+     *
+     * @param buffer Room for status.count ints
+     */
+    void recv(int *buffer, const ShmStatus &status)
+    {
+        auto it = find(status);
+        if (it == inbox.end())
+            return;
+        std::copy(it->data.begin(), it->data.end(), buffer);
+        inbox.erase(it);
+    }
+
+    /**
+     * Receive a message without payload, as recv() without a buffer
+     */
+    void recv_control(const ShmStatus &status)
+    {
+        auto it = find(status);
+        if (it != inbox.end())
+            inbox.erase(it);
+    }
+
+    /**
+     * Deliver the outbox and close the ring, called once when the process leaves the protocol
+     */
+    void close()
+    {
+        ring(rank_)->closed.store(1, std::memory_order_release);
+        while (!outbox.empty())
+        {
+            flush_outbox();
+            if (!outbox.empty())
+                sched_yield();
+        }
+    }
+
+private:
+    struct Message
+    {
+        int source;
+        int tag;
+        std::vector<int> data;
+    };
+
+    struct Pending
+    {
+        int dest;
+        int tag;
+        std::vector<int> data;
+    };
+
+    ShmRingControl *ring(int r) const { return (ShmRingControl *)(base + r * stride); }
+    uint32_t *ring_data(int r) const { return (uint32_t *)(base + r * stride + sizeof(ShmRingControl)); }
+
+    /**
+     * Append one record to the ring of dest
+     *
+     * @return false if the ring has no room, true if written or dropped for a closed ring
+     */
+    bool write(int dest, int tag, const int *data, int count)
+    {
+        ShmRingControl *r = ring(dest);
+        if (r->closed.load(std::memory_order_acquire))
+            return true;
+        uint32_t *ints = ring_data(dest);
+        while (r->lock.exchange(1, std::memory_order_acquire) != 0)
+            sched_yield();
+        uint64_t tail = r->tail.load(std::memory_order_relaxed);
+        if (tail - r->head.load(std::memory_order_acquire) + SHM_HEADER_INTS + count > ring_ints)
+        {
+            r->lock.store(0, std::memory_order_release);
+            return false;
+        }
+        uint32_t header[SHM_HEADER_INTS] = {(uint32_t)rank_, (uint32_t)tag, (uint32_t)count};
+        for (int i = 0; i < SHM_HEADER_INTS; i++)
+            ints[(tail + i) & (ring_ints - 1)] = header[i];
+        for (int i = 0; i < count; i++)
+            ints[(tail + SHM_HEADER_INTS + i) & (ring_ints - 1)] = (uint32_t)data[i];
+        r->tail.store(tail + SHM_HEADER_INTS + count, std::memory_order_release);
+        r->lock.store(0, std::memory_order_release);
+        r->signal.fetch_add(1, std::memory_order_acq_rel);
+        if (r->sleeping.load(std::memory_order_acquire))
+            futex(&r->signal, FUTEX_WAKE, 1, NULL);
+        return true;
+    }
+
+    /**
+     * @return The first inbox message from the source and with the tag of a status, or the end of the inbox
+     */
+    std::deque<Message>::iterator find(const ShmStatus &status)
+    {
+        for (auto it = inbox.begin(); it != inbox.end(); ++it)
+            if (it->source == status.source && it->tag == status.tag)
+                return it;
+        return inbox.end();
+    }
+
+    void flush_outbox()
+    {
+        while (!outbox.empty() && write(outbox.front().dest, outbox.front().tag, outbox.front().data.data(), (int)outbox.front().data.size()))
+            outbox.pop_front();
+    }
+
+    /**
+     * Move every record of the own ring into the inbox
+     */
+    void drain()
+    {
+        ShmRingControl *r = ring(rank_);
+        uint32_t *ints = ring_data(rank_);
+        uint64_t head = r->head.load(std::memory_order_relaxed), tail = r->tail.load(std::memory_order_acquire);
+        while (head < tail)
+        {
+            Message m;
+            m.source = (int)ints[head & (ring_ints - 1)];
+            m.tag = (int)ints[(head + 1) & (ring_ints - 1)];
+            m.data.resize(ints[(head + 2) & (ring_ints - 1)]);
+            for (size_t i = 0; i < m.data.size(); i++)
+                m.data[i] = (int)ints[(head + SHM_HEADER_INTS + i) & (ring_ints - 1)];
+            head += SHM_HEADER_INTS + m.data.size();
+            inbox.push_back(std::move(m));
+        }
+        r->head.store(head, std::memory_order_release);
+    }
+
+    /**
+     * Sleep until a writer signals the own ring, at most 1 ms while the outbox waits for room elsewhere
+     */
+    void wait()
+    {
+        ShmRingControl *r = ring(rank_);
+        uint32_t seen = r->signal.load(std::memory_order_acquire);
+        r->sleeping.store(1, std::memory_order_seq_cst);
+        if (r->head.load(std::memory_order_relaxed) == r->tail.load(std::memory_order_seq_cst)) // nothing arrived since the last drain
+        {
+            struct timespec retry = {0, 1000000};
+            futex(&r->signal, FUTEX_WAIT, seen, outbox.empty() ? NULL : &retry);
+        }
+        r->sleeping.store(0, std::memory_order_relaxed);
+    }
+
+    uint8_t *base;
+    int rank_;
+    int size_;
+    size_t ring_ints;
+    size_t stride;
+    std::deque<Message> inbox;
+    std::deque<Pending> outbox;
+};
+
+#endif
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Check that pddfs_batch prints the expected trees and skipped lines for a stream of graphs
+# Graphs are written as they finish, so the order of the lines is not compared.
+#
+# usage: tests/check_batch.sh <expected lines> <graphs> <command...>
+
+expected=$1
+graphs=$2
+shift 2
+actual=$("$@" < "$graphs" | sort)
+if [ "$actual" != "$(cat "$expected")" ]; then
+    echo "unexpected trees from $*:"
+    echo "$actual"
+    exit 1
+fi
+echo "batch OK: $*"
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Check that a recorded run of a PDDFS program replays
+# The recorded run has to print the expected DONE lines, and the replay the same lines including the message counts,
+# since it handles the same messages in the same order, without reporting a divergence from the recording.
+# With - as the expected lines any tree of the recorded run is accepted, for graphs whose tree depends on the message order.
+#
+# usage: tests/check_replay.sh <expected DONE lines> <edge list> <record prefix> <command...>
+
+expected=$1
+graph=$2
+prefix=$3
+shift 3
+rm -f "$prefix".*
+recorded=$("$@" --record "$prefix" < "$graph" | grep DONE | sort)
+if [ "$expected" != - ] && [ "$(echo "$recorded" | sed 's/\t\t[0-9]*$//')" != "$(cat "$expected")" ]; then
+    echo "unexpected tree from the recorded run of $*:"
+    echo "$recorded"
+    exit 1
+fi
+output=$("$@" --replay "$prefix" < "$graph")
+if echo "$output" | grep -q "diverged\|cannot replay"; then
+    echo "the replay of $* diverged or did not read the recording:"
+    echo "$output"
+    exit 1
+fi
+replayed=$(echo "$output" | grep DONE | sort)
+if [ "$replayed" != "$recorded" ]; then
+    echo "the replay of $* printed other DONE lines:"
+    echo "$replayed"
+    exit 1
+fi
+echo "replay OK: $*"
@@ -0,0 +1,16 @@
+#!/bin/sh
+# Check that a PDDFS program prints the expected DONE lines for a graph
+# The message counts at the end of the lines differ from run to run and are not compared, the order of the lines neither.
+#
+# usage: tests/check_tree.sh <expected DONE lines> <edge list> <command...>
+
+expected=$1
+graph=$2
+shift 2
+actual=$("$@" < "$graph" | grep DONE | sed 's/\t\t[0-9]*$//' | sort)
+if [ "$actual" != "$(cat "$expected")" ]; then
+    echo "unexpected tree from $*:"
+    echo "$actual"
+    exit 1
+fi
+echo "tree OK: $*"
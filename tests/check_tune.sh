@@ -0,0 +1,23 @@
+#!/bin/sh
+# Check that a PDDFS program tunes itself as expected and still prints the expected DONE lines
+# The TUNE line is matched as an extended regular expression, the huge page mode depends on the kernel.
+#
+# usage: tests/check_tune.sh <expected DONE lines> <edge list> <TUNE line pattern> <command...>
+
+expected=$1
+graph=$2
+pattern=$3
+shift 3
+output=$("$@" < "$graph")
+if ! echo "$output" | grep -Eq "$pattern"; then
+    echo "no TUNE line matching $pattern from $*:"
+    echo "$output" | grep TUNE
+    exit 1
+fi
+actual=$(echo "$output" | grep DONE | sed 's/\t\t[0-9]*$//' | sort)
+if [ "$actual" != "$(cat "$expected")" ]; then
+    echo "unexpected tree from $*:"
+    echo "$actual"
+    exit 1
+fi
+echo "tune OK: $*"
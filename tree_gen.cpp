@@ -0,0 +1,51 @@
+/**
+* Generate random connected graphs with few cycles as input for the PDDFS algorithm
+* Every vertex v > 0 is attached to a random vertex before it, which gives a random tree, then extra edges between random
+* pairs of vertices that are not yet connected are added, each of which closes a cycle.
+* On a tree (no extra edges) every vertex receives a single DISCOVER and the protocol always terminates; every extra edge
+* adds competing paths, on which runs can stall (see the README), so benchmarks that must finish use few or none.
+* The program takes the number of nodes, the number of extra edges and an optional seed (default 1) as arguments
+* Edges are printed in both directions, sorted by source
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+
+using namespace std;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        cerr << "usage: " << argv[0] << " <vertices> <extra edges> [seed]" << endl;
+        return 1;
+    }
+    int n = stoi(argv[1]);
+    long extra = stol(argv[2]);
+    mt19937 random(argc > 3 ? stoul(argv[3]) : 1);
+    extra = n < 2 ? 0 : min(extra, (long)n * (n - 1) / 2 - (n - 1)); // a complete graph has no room for more
+    set<pair<int, int>> edges;
+    for (int v = 1; v < n; v++)
+    {
+        int u = uniform_int_distribution<int>(0, v - 1)(random);
+        edges.insert(make_pair(u, v));
+        edges.insert(make_pair(v, u));
+    }
+    uniform_int_distribution<int> vertex(0, max(n - 1, 0));
+    for (long added = 0; added < extra;)
+    {
+        int u = vertex(random), v = vertex(random);
+        if (u != v && edges.insert(make_pair(u, v)).second)
+        {
+            edges.insert(make_pair(v, u));
+            added++;
+        }
+    }
+    for (const pair<int, int> &edge : edges)
+        cout << edge.first << " " << edge.second << "\n";
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * Streaming output of the finished part of the DFS tree
+ * A vertex terminates once all its children have terminated, from then on its parent and children never change. With
+ * --tree-stream <file> every process appends the record of its vertex to the file the moment the vertex terminates, before
+ * it sends TERMINATE to its parent. The record of a vertex is therefore written after the records of its whole subtree, so
+ * a consumer reading the file while the run goes on can process a subtree as soon as it reads the record of its top vertex,
+ * and the record of the root is the last one. One line per vertex, tab separated, original vertex IDs:
+ *   <vertex> <parent> <children, comma separated>
+ * Every record is one write() on a descriptor opened with O_APPEND, so records of different processes do not interleave in a
+ * local file or a named pipe (records up to PIPE_BUF bytes). Files on network file systems may not keep this order.
+ */
+
+#ifndef TREE_STREAM_H
+#define TREE_STREAM_H
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include "vertex_state.h"
+
+/**
+ * Open the tree stream of a process
+ *
+ * @param path The stream file, a regular file or a named pipe
+ * @param truncate Empty an existing file, done by one process before the others open it
+ * @return The descriptor, -1 if the file cannot be opened
+ */
+inline int open_tree_stream(const char *path, bool truncate)
+{
+    return open(path, O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+}
+
+/**
+ * Append the final record of a terminated vertex in one write
+ *
+ * @param fd The tree stream
+ * @param v The state of the vertex
+ * @return false if the record was not written completely
+ */
+inline bool write_tree_record(int fd, const VertexState &v)
+{
+    std::string record = std::to_string(v.id) + "\t" + std::to_string(v.id == 0 ? -1 : v.parent) + "\t";
+    bool first = true;
+    for (int id : v.neighbours.collect(NEIGHBOUR_CHILD)) // ascending, also for a keyed row
+    {
+        record += (first ? "" : ",") + std::to_string(id);
+        first = false;
+    }
+    record += "\n";
+    return write(fd, record.data(), record.size()) == (ssize_t)record.size();
+}
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * The protocol of one vertex in Musaev's PDDFS algorithm, written once for every transport
+ * The handlers for DISCOVER, REJECT and TERMINATE and the loop around them are templates over the transport that carries
+ * the messages: MPI (pddfs.cpp), shared memory rings (pddfs_shm.cpp) and the coroutine actors (pddfs_actors.cpp), which
+ * await their messages themselves and call the steps of the loop directly.
+ *
+ * A transport provides, with Status a type that has the members source (the rank of the sender), tag and count:
+ *   void wait(Status *status)                                  wait for the next message to handle, blocking transports only
+ *   int receive_path(const Status &status, large_vector<int> &buffer)
+ *                                                              receive a DISCOVER into buffer, grown with fit_path() where
+ *                                                              needed, returns the length of the path without any trailer
+ *   void receive_control(const Status &status)                 receive a REJECT or TERMINATE
+ *   void send_discover(const NeighbourTable &neighbours, int dest, int path[], int path_length)
+ *                                                              path has room for the hop to dest, see fit_path()
+ *   void send_reject(const NeighbourTable &neighbours, int dest)
+ *   void send_terminate(const NeighbourTable &neighbours, int dest)
+ *   void terminating(const VertexState &v)                     the subtree of the vertex is done, before TERMINATE is sent
+ *   void handled(const VertexState &v, const Status &status)   after every handled message
+ *   auto profiled(ProfileSection section, F f)                 call f() charged to a section of the handler profile
+ * Destinations are original vertex IDs, a transport that addresses ranks translates them with neighbours.rank_of().
+ * BasicTransport has the hooks that do nothing.
+ */
+
+#ifndef VERTEX_PROTOCOL_H
+#define VERTEX_PROTOCOL_H
+
+#include <algorithm>
+#include "protocol_core.h"
+#include "vertex_state.h"
+
+/**
+ * The optional parts of a transport, for transports without instrumentation
+ */
+struct BasicTransport
+{
+    void terminating(const VertexState &) {}
+
+    template <typename Status>
+    void handled(const VertexState &, const Status &) {}
+
+    template <typename F>
+    auto profiled(ProfileSection, F f) -> decltype(f())
+    {
+        return f();
+    }
+};
+
+/**
+ * Send DISCOVER to every child, in the preferred order
+ */
+template <typename Transport>
+void send_discover_to_children(Transport &t, const NeighbourTable &neighbours, int path[], int path_length)
+{
+    neighbours.for_each_child([&](int dest, int)
+                              { t.send_discover(neighbours, dest, path, path_length); });
+}
+
+/**
+ * Replace the current path by the received one
+ */
+inline void adopt_received_path(VertexState &v, int recv_path_length)
+{
+    fit_path(v.path, recv_path_length);
+    std::copy(v.recv_path.begin(), v.recv_path.begin() + recv_path_length, v.path.begin());
+    v.path_length = recv_path_length;
+}
+
+/**
+ * Start the search if the current vertex is the root
+ *
+ * @param row The compressed neighbour row, materialised into the neighbour table on mount
+ */
+template <typename Transport>
+void start_vertex(Transport &t, VertexState &v, const uint8_t *row)
+{
+    if (v.id != 0)
+        return;
+    v.set_flag(VERTEX_MOUNTED, true);
+    v.neighbours.assign(row, *v.ids);
+    fit_path(v.path, v.neighbours.entry_ints());
+    v.path_length = v.neighbours.root_path(v.path.data(), 0);
+    send_discover_to_children(t, v.neighbours, v.path.data(), v.path_length);
+}
+
+/**
+ * Handle a DISCOVER message: mount the vertex, or compare the received path with the current one
+ *
+ * @param row The compressed neighbour row, materialised into the neighbour table on mount
+ * @param status The status of the message, the message is received here
+ */
+template <typename Transport, typename Status>
+void handle_discover(Transport &t, VertexState &v, const uint8_t *row, const Status &status)
+{
+    int source = v.ids->original_id(status.source); // the protocol is defined on original vertex IDs
+    if (!v.mounted()) // Node is not yet attached to DFS tree
+    {
+        v.set_flag(VERTEX_MOUNTED, true);
+        v.parent = source;
+        t.profiled(PROFILE_CHILD_SET, [&]()
+                   {
+            v.neighbours.assign(row, *v.ids);
+            v.neighbours.erase_child(v.parent); });
+        v.path_length = t.receive_path(status, v.path);
+        send_discover_to_children(t, v.neighbours, v.path.data(), v.path_length);
+        return;
+    }
+
+    int recv_path_length = t.receive_path(status, v.recv_path);
+    int order = t.profiled(PROFILE_PATH_ORDER, [&]()
+                           { return path_order(v.path_length, v.path.data(), recv_path_length, v.recv_path.data()); });
+    if (source == v.parent)
+    { // sometimes you may get the same path you already have, ignore this.
+        if (order == 1)
+            adopt_received_path(v, recv_path_length); // sometimes the path from parent is better, update own path to save some work
+    }
+    else if (order == 1) // recv path >df curr path: update own path, update parent, send DISCOVER to old parent
+    {
+        adopt_received_path(v, recv_path_length);
+        if (!v.parent_rejected())
+        {
+            t.profiled(PROFILE_CHILD_SET, [&]()
+                       { v.neighbours.insert_child(v.parent); }); // old parent becomes child
+            t.send_discover(v.neighbours, v.parent, v.path.data(), v.path_length); // send updated path to old parent
+        }
+        v.parent = source; // change parent
+        v.parent_changes++;
+        v.set_flag(VERTEX_PARENT_REJECTED, false);
+        t.profiled(PROFILE_CHILD_SET, [&]()
+                   { v.neighbours.erase_child(v.parent); }); // remove new parent from children
+    }
+    else if (order == 0) // curr path \subsetdf recv path: remove sender or t from children, send reject to sender
+    {
+        int link = v.neighbours.hop_at(v.recv_path.data(), v.path_length); // link t is the other link that connects p to the loop
+        int rejected = v.neighbours.before(link, source) ? source : link; // if the path through t is more df, sender needs to be rejected
+        t.profiled(PROFILE_CHILD_SET, [&]()
+                   { v.neighbours.erase_child(rejected); });
+        t.send_reject(v.neighbours, rejected);
+    }
+    else // curr path more df than recv path, send path back to sender
+        t.send_discover(v.neighbours, source, v.path.data(), v.path_length);
+}
+
+/**
+ * Handle a REJECT message: a rejected parent is remembered, a rejected child is removed
+ */
+template <typename Transport, typename Status>
+void handle_reject(Transport &t, VertexState &v, const Status &status)
+{
+    t.receive_control(status);
+    int source = v.ids->original_id(status.source);
+    if (source == v.parent)
+        v.set_flag(VERTEX_PARENT_REJECTED, true);
+    else
+        t.profiled(PROFILE_CHILD_SET, [&]()
+                   { v.neighbours.erase_child(source); });
+}
+
+/**
+ * Handle a TERMINATE message: the sender is marked as terminated
+ */
+template <typename Transport, typename Status>
+void handle_terminate(Transport &t, VertexState &v, const Status &status)
+{
+    t.receive_control(status);
+    t.profiled(PROFILE_CHILD_SET, [&]()
+               { v.neighbours.mark_terminated(v.ids->original_id(status.source)); });
+}
+
+/**
+ * Handle the message of a status with the handler of its type
+ */
+template <typename Transport, typename Status>
+void handle_message(Transport &t, VertexState &v, const uint8_t *row, const Status &status)
+{
+    switch (status.tag)
+    {
+    case DISCOVER_TYPE:
+        t.profiled(PROFILE_DISCOVER, [&]()
+                   { handle_discover(t, v, row, status); });
+        break;
+    case REJECT_TYPE:
+        t.profiled(PROFILE_REJECT, [&]()
+                   { handle_reject(t, v, status); });
+        break;
+    case TERMINATE_TYPE:
+        t.profiled(PROFILE_TERMINATE, [&]()
+                   { handle_terminate(t, v, status); });
+        break;
+    }
+    t.handled(v, status);
+}
+
+/**
+ * Terminate the vertex once all its children have terminated, TERMINATE goes to the parent
+ * Checked before every wait, so a root without neighbours terminates without waiting for a message.
+ *
+ * @return true if the vertex has terminated
+ */
+template <typename Transport>
+bool finish_vertex(Transport &t, VertexState &v)
+{
+    if (!v.mounted() || !v.neighbours.all_children_terminated())
+        return false;
+    t.terminating(v);
+    if (v.id != 0)
+        t.send_terminate(v.neighbours, v.parent);
+    return true;
+}
+
+/**
+ * Run the protocol of the vertex until it terminates, on a transport that can wait for its messages
+ *
+ * @param row The compressed neighbour row of the vertex (compressed_adjacency.h)
+ * @return The amount of messages handled
+ */
+template <typename Transport>
+int run_vertex(Transport &t, VertexState &v, const uint8_t *row)
+{
+    start_vertex(t, v, row);
+    int msgct = 0;
+    while (!finish_vertex(t, v))
+    {
+        typename Transport::Status status;
+        t.wait(&status);
+        msgct++;
+        handle_message(t, v, row, status);
+    }
+    return msgct;
+}
+
+#endif
@@ -0,0 +1,255 @@
+/**
+ * Protocol state of a vertex in the PDDFS algorithm
+ * The state that is touched for every message is kept in a few dense columns instead of node-based sets:
+ * the neighbours of the vertex are one sorted id column with a parallel column of packed flag bits,
+ * and the child and terminated counters are maintained next to them, so the termination check is a comparison of two ints.
+ * Vertex-level booleans (mounted, parent rejected) share one flag byte.
+ */
+
+#ifndef VERTEX_STATE_H
+#define VERTEX_STATE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "compressed_adjacency.h"
+#include "protocol_core.h"
+#include "reorder.h"
+
+#define VERTEX_MOUNTED 0x1
+#define VERTEX_PARENT_REJECTED 0x2
+
+#define NEIGHBOUR_CHILD 0x1
+#define NEIGHBOUR_TERMINATED 0x2
+
+#define PATH_SLACK_INTS 4 // room behind a path: one more (key, vertex) entry and the latency stamp (MESSAGE_STAMP_INTS)
+
+/**
+ * Struct-of-arrays table of the neighbours of one vertex
+ * Entry i of every column describes the neighbour ids[i], ids are original vertex IDs sorted ascending
+ * and ranks[i] is the rank hosting the neighbour
+ * For a keyed row keys[i] is the ordering key of the edge to ids[i]: the DFS prefers neighbours by (key, id) instead of
+ * by id alone, in the fan-out order, in the paths (see path_entry_ints()) and when a cycle is broken.
+ */
+class NeighbourTable
+{
+public:
+    NeighbourTable() : keyed(false), child_count(0), terminated_count(0) {}
+
+    /**
+     * Materialise the table from a compressed row, all neighbours start as children
+     *
+     * @param row The compressed neighbour row of the vertex
+     * @param vertex_ids Translation from vertex IDs to the ranks hosting them
+     */
+    void assign(const uint8_t *row, const VertexIds &vertex_ids)
+    {
+        NeighbourRange neighbours(row);
+        ids.assign(neighbours.begin(), neighbours.end());
+        ranks.resize(ids.size());
+        for (size_t i = 0; i < ids.size(); i++)
+            ranks[i] = vertex_ids.rank_of(ids[i]);
+        flags.assign(ids.size(), NEIGHBOUR_CHILD);
+        child_count = (int)ids.size();
+        terminated_count = 0;
+        keyed = neighbours.keyed();
+        keys.clear();
+        fan_out.clear();
+        if (!keyed)
+            return;
+        keys.resize(ids.size());
+        const uint8_t *pos = neighbours.keys();
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            uint32_t key;
+            pos = varint_get(pos, &key);
+            keys[i] = (int)key;
+        }
+        fan_out.resize(ids.size());
+        for (size_t i = 0; i < ids.size(); i++)
+            fan_out[i] = (int)i;
+        std::sort(fan_out.begin(), fan_out.end(), [&](int a, int b)
+                  { return keys[a] != keys[b] ? keys[a] < keys[b] : a < b; });
+    }
+
+    /**
+     * @return The column index of neighbour id, -1 if id is not a neighbour
+     */
+    int index_of(int id) const
+    {
+        auto it = std::lower_bound(ids.begin(), ids.end(), id);
+        return it != ids.end() && *it == id ? (int)(it - ids.begin()) : -1;
+    }
+
+    /**
+     * @return The rank hosting neighbour id, -1 if id is not a neighbour
+     */
+    int rank_of(int id) const
+    {
+        int i = index_of(id);
+        return i >= 0 ? ranks[i] : -1;
+    }
+
+    /**
+     * @return The ordering key of the edge to neighbour id, 0 in an unkeyed row or if id is not a neighbour
+     */
+    int key_of(int id) const
+    {
+        int i = keyed ? index_of(id) : -1;
+        return i >= 0 ? keys[i] : 0;
+    }
+
+    /**
+     * @return true if the DFS prefers neighbour a over neighbour b, ordered by (key, id)
+     */
+    bool before(int a, int b) const
+    {
+        int key_a = key_of(a), key_b = key_of(b);
+        return key_a != key_b ? key_a < key_b : a < b;
+    }
+
+    /**
+     * @return The ints of one path entry, see path_entry_ints()
+     */
+    int entry_ints() const { return path_entry_ints(keyed); }
+
+    /**
+     * Write the path of the root
+     *
+     * @param path The buffer, room for one entry
+     * @param root The root vertex
+     * @return The length of the path
+     */
+    int root_path(int path[], int root) const
+    {
+        if (keyed)
+            path[0] = 0; // every path starts with the same entry, its key never decides
+        path[entry_ints() - 1] = root;
+        return entry_ints();
+    }
+
+    /**
+     * Append the hop to neighbour dest to a path
+     *
+     * @return The length of the extended path
+     */
+    int append_hop(int path[], int path_length, int dest) const
+    {
+        if (keyed)
+            path[path_length] = key_of(dest);
+        path[path_length + entry_ints() - 1] = dest;
+        return path_length + entry_ints();
+    }
+
+    /**
+     * @return The vertex of the path entry that starts at position
+     */
+    int hop_at(const int path[], int position) const { return path[position + entry_ints() - 1]; }
+
+    void insert_child(int id) { set_flag(id, NEIGHBOUR_CHILD, child_count); }
+    void erase_child(int id) { clear_flag(id, NEIGHBOUR_CHILD, child_count); }
+    void mark_terminated(int id) { set_flag(id, NEIGHBOUR_TERMINATED, terminated_count); }
+
+    int children() const { return child_count; }
+    int terminated() const { return terminated_count; }
+    bool all_children_terminated() const { return terminated_count == child_count; }
+
+    /**
+     * Call f(id, rank) for every child in the order the DFS prefers them, ascending (key, id)
+     */
+    template <typename F>
+    void for_each_child(F f) const
+    {
+        for (size_t j = 0; j < ids.size(); j++)
+        {
+            size_t i = keyed ? fan_out[j] : j;
+            if (flags[i] & NEIGHBOUR_CHILD)
+                f(ids[i], ranks[i]);
+        }
+    }
+
+    /**
+     * @return The ids of all neighbours with the given flag set, in ascending order
+     */
+    std::vector<int> collect(uint8_t flag) const
+    {
+        std::vector<int> out;
+        for (size_t i = 0; i < ids.size(); i++)
+            if (flags[i] & flag)
+                out.push_back(ids[i]);
+        return out;
+    }
+
+    std::vector<int> ids;
+    std::vector<int> ranks;
+    std::vector<uint8_t> flags;
+    std::vector<int> keys; // empty for an unkeyed row
+    bool keyed;
+
+private:
+    void set_flag(int id, uint8_t flag, int &count)
+    {
+        int i = index_of(id);
+        if (i >= 0 && !(flags[i] & flag))
+        {
+            flags[i] |= flag;
+            count++;
+        }
+    }
+
+    void clear_flag(int id, uint8_t flag, int &count)
+    {
+        int i = index_of(id);
+        if (i >= 0 && (flags[i] & flag))
+        {
+            flags[i] &= ~flag;
+            count--;
+        }
+    }
+
+    std::vector<int> fan_out; // column indices in (key, id) order, empty for an unkeyed row
+    int child_count;
+    int terminated_count;
+};
+
+/**
+ * Everything a vertex knows during the algorithm
+ */
+struct VertexState
+{
+    /**
+     * @param id The original ID of the vertex
+     * @param max_path The longest path a vertex can receive, the amount of vertices in the graph times path_entry_ints(),
+     *                 0 for path buffers that start small and grow with the paths (see fit_path())
+     * @param ids Translation between ranks and original vertex IDs, must outlive the state
+     */
+    VertexState(int id, int max_path, const VertexIds &ids) : id(id), parent(-1), flags(0), path_length(0), parent_changes(0),
+                                                              path(max_path + PATH_SLACK_INTS), recv_path(max_path + PATH_SLACK_INTS), ids(&ids) {}
+
+    bool mounted() const { return flags & VERTEX_MOUNTED; }
+    bool parent_rejected() const { return flags & VERTEX_PARENT_REJECTED; }
+    void set_flag(uint8_t flag, bool on) { flags = on ? flags | flag : flags & ~flag; }
+
+    int id;     // original vertex ID, all protocol decisions use original IDs
+    int parent; // original vertex ID of the parent
+    uint8_t flags;
+    int path_length;
+    long parent_changes; // times a more depth-first path replaced the parent
+    large_vector<int> path;      // current path from the root, with room to append a destination
+    large_vector<int> recv_path; // receive buffer for DISCOVER paths
+    NeighbourTable neighbours;
+    const VertexIds *ids;
+};
+
+/**
+ * Make room in a path buffer for a path of length ints and what is appended to it before it is sent
+ * Buffers sized for the longest path never grow here, so a path that is still being sent is never moved.
+ */
+inline void fit_path(large_vector<int> &buffer, int length)
+{
+    if (buffer.size() < (size_t)length + PATH_SLACK_INTS)
+        buffer.resize(length + PATH_SLACK_INTS);
+}
+
+#endif